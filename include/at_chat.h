@@ -29,6 +29,18 @@
 #include "at_port.h"
 #include <stdbool.h>
 #include <stdarg.h>
+#if AT_TIMER_WHEEL_EN
+#include "linux_list.h"
+#endif
+
+#if AT_SYNC_EN && !AT_WORK_CONTEXT_EN
+    #error "AT_SYNC_EN requires AT_WORK_CONTEXT_EN"
+#endif
+
+/**
+ *@brief Indicates that the AT object has nothing to wait for (ref@at_obj_next_deadline).
+ */
+#define AT_WAIT_FOREVER 0xFFFFFFFFu
 
 struct at_obj;                      
 struct at_adapter;                  
@@ -52,7 +64,8 @@ typedef enum {
     AT_RESP_OK = 0,                 
     AT_RESP_ERROR,                  
     AT_RESP_TIMEOUT,                
-    AT_RESP_ABORT                   
+    AT_RESP_ABORT,
+    AT_RESP_EXPIRED                /* The work was not started within its queue time to live (ref@at_attr_t.ttl)*/
 } at_resp_code;
 
 /**
@@ -60,7 +73,9 @@ typedef enum {
  */
 typedef enum {
     AT_PRIORITY_LOW = 0,
-    AT_PRIORITY_HIGH   
+    AT_PRIORITY_HIGH,
+    AT_PRIORITY_URGENT,            /* Such as hang-up*/
+    AT_PRIORITY_CRITICAL           /* Such as emergency message*/
 } at_cmd_priority;
 
 /**
@@ -95,8 +110,25 @@ typedef struct {
      *                    to receive the remaining data and continues to call back this interface).
      */    
     int (*handler)(at_urc_info_t *info);
+#if AT_URC_DEFER_EN
+    /* Dispatch the frame with at_obj_urc_dispatch (the handler must return 0, items that 
+       need to receive more bytes cannot be deferred).*/
+    unsigned char defer;
+#endif
 } urc_item_t;
 
+#if AT_URC_DEFER_EN
+/**
+ * @brief Deferred URC queue statistics.
+ */
+typedef struct {
+    unsigned int queued;           /* Frames pushed into the queue*/
+    unsigned int dispatched;       /* Frames dispatched by at_obj_urc_dispatch*/
+    unsigned int dropped;          /* Frames dropped because the queue was full*/
+    unsigned int stalls;           /* Times the reading was paused because the queue was almost full*/
+} at_urc_stats_t;
+#endif
+
 /**
  * @brief AT response information
  */
@@ -146,6 +178,14 @@ typedef struct {
     unsigned int (*read) (void *buf, unsigned int len);
 } at_raw_trans_conf_t;
 
+/**
+ * @brief Scatter-gather data block
+ */
+typedef struct {
+    const void   *base;            /* Data buffer*/
+    unsigned int  len;             /* Data length*/
+} at_iovec_t;
+
 /**
  * @brief AT interface adapter
  */
@@ -183,8 +223,72 @@ typedef struct  {
 #endif    
     //Command response receiving buffer size, set according to the actual maximum command response length
     unsigned short recv_bufsize;
+    /**
+     * @brief       Scatter-gather write operation (non-blocking), fill in NULL if not required
+     *              (the data blocks are written one by one through 'write' instead).
+     * @param       iov    Data blocks
+     * @param       iovcnt Number of data blocks
+     * @return      Indicates the length of the written data
+     */
+    unsigned int (*writev)(const at_iovec_t *iov, int iovcnt);
+    /**
+     * @brief       Wake up the thread that runs at_obj_process (invoked when a work is submitted
+     *              or aborted, and by at_obj_notify_rx), fill in NULL if not required.
+     */
+    void (*wakeup)(void);
 } at_adapter_t;
 
+/**
+ * @brief AT interface adapter with object context (ref@at_obj_create_ex).
+ *        Each interface receives the AT object it belongs to, so that a single driver 
+ *        implementation can serve multiple devices (the device context can be obtained 
+ *        through at_obj_get_user_data) and each device can have its own lock.
+ */
+typedef struct  {
+    //Lock, used in OS environment, fill in NULL if not required.
+    void (*lock)(struct at_obj *obj);
+    //Unlock, used in OS environment, fill in NULL if not required.
+    void (*unlock)(struct at_obj *obj);
+    /**
+     * @brief       Data write operation (non-blocking)
+     * @param       obj   AT object
+     * @param       buf   Data buffer
+     * @param       len    data length
+     * @return      Indicates the length of the written data
+     */    
+    unsigned int (*write)(struct at_obj *obj, const void *buf, unsigned int len); 
+    /**
+     * @brief       Data read operation (non-blocking)
+     * @param       obj   AT object
+     * @param       buf   Data buffer
+     * @param       len    data length
+     * @return      The length of the data actually read
+     */        
+    unsigned int (*read)(struct at_obj *obj, void *buf, unsigned int len);       
+    /**
+     * @brief       Scatter-gather write operation (non-blocking), fill in NULL if not required.
+     */
+    unsigned int (*writev)(struct at_obj *obj, const at_iovec_t *iov, int iovcnt);
+    /**
+     * @brief       Wake up the thread that runs at_obj_process, fill in NULL if not required.
+     */
+    void (*wakeup)(struct at_obj *obj);
+    /**
+     * @brief       AT error event (the AT object is given by at_response_t.obj), fill in NULL if not required.
+     */    
+    void (*error)(at_response_t *);
+    /**
+     * @brief       Log output interface, fill in NULL if not required.
+     */      
+    void (*debug)(struct at_obj *obj, const char *fmt, ...);  
+#if AT_URC_WARCH_EN
+    //URC buffer size, set according to the actual maximum URC frame when used.
+	unsigned short urc_bufsize;
+#endif    
+    //Command response receiving buffer size, set according to the actual maximum command response length
+    unsigned short recv_bufsize;
+} at_adapter_ex_t;
+
 /**
  * @brief Public environment for AT work 
  */
@@ -248,10 +352,28 @@ typedef struct {
     unsigned short  bufsize;      /* Indicates receive buffer size*/
     unsigned short  resplen;      /* Indicates the actual response valid data length*/
     unsigned char   *respbuf;     /* Point to the receive buffer*/
+#if AT_SYNC_EN
+    at_sem_t        sem;          /* Completion semaphore (ref@at_context_sync_init)*/
+#endif
 } at_context_t;
 
 #endif
 
+#if AT_RETRY_POLICY_EN
+/**
+ *@brief Retry policy, the delay before the n-th resend is min(base * (multiplier/100)^(n-1), cap), 
+ *       then randomly reduced by up to 'jitter' percent.
+ */
+typedef struct {
+    unsigned short base;          /* Delay(ms) before the first resend*/
+    unsigned short multiplier;    /* Delay growth of each resend(%), e.g. 200: double, 100: constant*/
+    unsigned short cap;           /* Maximum delay(ms), 0: 65535*/
+    unsigned char  jitter;        /* Random reduction of the delay(%, 0~100)*/
+    unsigned char  error_retry;   /* Resends after error responses*/
+    unsigned char  timeout_retry; /* Resends after response timeouts*/
+} at_retry_policy_t;
+#endif
+
 /**
  *@brief AT attributes
  */
@@ -266,13 +388,143 @@ typedef struct {
     unsigned short timeout;      /* Response timeout(ms).. */
     unsigned char  retry;        /* Response error retries. */
     at_cmd_priority priority;    /* Command execution priority. */
+    /* Deadline(ms after submission), the works of the same priority are executed in 
+       earliest-deadline-first order (before the works without deadline), 0: none. */
+    unsigned short deadline;
+    /* Queue time to live(s, 1~63), the work that has not been started within it is finished 
+       with AT_RESP_EXPIRED without being sent, 0: none. The expired works are finished 
+       before the next work starts, so the callback is late by at most the running time 
+       of the work being executed when it expires. */
+    unsigned char  ttl;
+#if AT_RETRY_POLICY_EN
+    /* Retry policy used instead of 'retry' and the fixed resending delay, NULL: none.
+       Only the address is saved, the policy must be a global resident object. */
+    const at_retry_policy_t *retry_policy;
+#endif
+#if AT_ADAPTIVE_TIMEOUT_EN
+    /* Set the receive timeout from the measured response time of the command verb (clamped
+       to AT_RTO_MIN~AT_RTO_MAX), 'timeout' is used until the first response is measured. */
+    unsigned char  adaptive;
+#endif
+#if AT_RESP_CACHE_EN
+    /* Cache time to live(s) of the successful response, while it is fresh the identical 
+       command is completed immediately with the cached response without being sent, 
+       0: no cache. Only for at_exec_cmd/at_send_singlline. On a hit the callback is invoked
+       before the submitting function returns (re-entrantly in the caller's thread), or it 
+       is queued if a completion queue is bound (ref@at_obj_set_cq). */
+    unsigned short cache;
+#endif
+#if AT_COALESCE_EN
+    /* Attach the command to an identical command (also with 'coalesce' set, same prefix,
+       suffix, ttl and deadline) waiting in the queue of the same priority, both are completed
+       from one response.
+       Only for at_exec_cmd/at_send_singlline. */
+    unsigned char  coalesce;
+#endif
 } at_attr_t;
 
+#if AT_RESP_CACHE_EN
+/**
+ *@brief Response cache statistics.
+ */
+typedef struct {
+    unsigned int   hits;           /* Commands completed with the cached response*/
+    unsigned int   misses;         /* Commands with 'cache' set that had to be sent*/
+    unsigned short entries;        /* Number of cached responses*/
+    unsigned short bytes;          /* Memory used by the cached commands and responses*/
+} at_cache_stats_t;
+#endif
+
+#if AT_ADAPTIVE_TIMEOUT_EN
+/**
+ *@brief Response time statistics of a command verb (ref@at_attr_t.adaptive).
+ */
+typedef struct {
+    unsigned int   srtt;           /* Smoothed response time(ms)*/
+    unsigned int   rttvar;         /* Response time variation(ms)*/
+    unsigned int   timeout;        /* Receive timeout(ms) that the next command will use*/
+} at_rtt_stats_t;
+#endif
+
+#if AT_CQ_EN
+/**
+ *@brief Completion queue entry (a finished work whose callback has not been dispatched).
+ */
+typedef struct {
+    at_callback_t   cb;           /* Response callback handler*/
+    void           *params;       /* User parameters (referenced from ->at_attr_t.params)*/
+    at_resp_code    code;         /* AT command response code.*/
+    unsigned short  recvcnt;      /* Receive data length*/
+    unsigned short  prefix;       /* Offset of the response prefix*/
+    unsigned short  suffix;       /* Offset of the response suffix*/
+    unsigned int    data;         /* Position of the response in the data ring*/
+    unsigned int    data_end;     /* End of the response in the data ring (free running)*/
+} at_cqe_t;
+
+/**
+ *@brief Completion queue (producer: at_obj_process, and the submitting functions on response 
+ *       cache hits, serialized by the adapter lock; single consumer: at_cq_reap).
+ */
+typedef struct at_cq {
+    at_cqe_t       *entries;      /* Entry ring*/
+    char           *data;         /* Response data ring*/
+    unsigned int    entry_count;  /* Number of entries (power of 2)*/
+    unsigned int    data_size;    /* Data ring size (power of 2)*/
+    unsigned int    head, tail;   /* Entry ring position (free running)*/
+    unsigned int    data_head, data_tail;
+    unsigned int    overflow;     /* Times a completion did not fit (it is queued later)*/
+    /**
+     * @brief  Invoked after a completion is queued (in the thread of at_obj_process),
+     *         it can be used to wake up the reaping thread, fill in NULL if not required.
+     */
+    void          (*notify)(struct at_cq *cq);
+} at_cq_t;
+#endif
+
+#if AT_TIMER_WHEEL_EN
+/**
+ *@brief Timer of the timer wheel.
+ */
+typedef struct {
+    struct list_head node;
+    unsigned int     expires;       /* Expiration time(ms)*/
+    unsigned short   slot;          /* Slot that the timer is in*/
+} at_timer_t;
+
+/**
+ *@brief Hashed timer wheel, timers are hashed into AT_WHEEL_SLOTS slots by their 
+ *       expiration time (1ms per slot), adding and removing a timer is O(1).
+ */
+typedef struct {
+    struct list_head slots[AT_WHEEL_SLOTS];
+    unsigned int     bitmap[AT_WHEEL_SLOTS / 32];  /* Non-empty slots*/
+    unsigned int     current;                      /* Time that has been processed(ms)*/
+    int              count;                        /* Number of timers*/
+} at_wheel_t;
+
+/**
+ *@brief Scheduler of AT objects (ref@at_sched_poll), it keeps the objects that need to be 
+ *       processed in a ready list and the deadlines of the others in a timer wheel.
+ */
+typedef struct {
+    at_wheel_t       wheel;
+    struct list_head ready;         /* Objects to be processed (protected by lock)*/
+    /**
+     * @brief Protect the ready list, objects are made ready by at_obj_notify_rx and the 
+     *        submitting functions, which may be invoked in other threads or interrupts.
+     *        Fill in NULL if all of them are invoked in the thread of at_sched_poll.
+     */
+    void           (*lock)(void);
+    void           (*unlock)(void);
+} at_sched_t;
+#endif
+
 /**
  *@brief AT object.
  */
 typedef struct at_obj {
-    const at_adapter_t *adap;    
+    const at_adapter_t *adap;             /* Adapter (NULL if the object is created by at_obj_create_ex)*/
+    const at_adapter_ex_t *adap_ex;       /* Adapter with object context (NULL if the object is created by at_obj_create)*/
 #if AT_RAW_TRANSPARENT_EN    
     const at_raw_trans_conf_t *raw_conf;  
 #endif    
@@ -281,6 +533,8 @@ typedef struct at_obj {
 
 at_obj_t *at_obj_create(const at_adapter_t *);
 
+at_obj_t *at_obj_create_ex(const at_adapter_ex_t *adap, void *user_data);
+
 void at_obj_destroy(at_obj_t *at);
 
 bool at_obj_busy(at_obj_t *at);
@@ -288,6 +542,8 @@ bool at_obj_busy(at_obj_t *at);
 void at_obj_set_user_data(at_obj_t *at, void *user_data);
 
 void *at_obj_get_user_data(at_obj_t *at);
+
+void at_obj_write(at_obj_t *at, const void *buf, unsigned int len);
 #if AT_URC_WARCH_EN
 void at_obj_set_urc(at_obj_t *at, const urc_item_t *tbl, int count);
 
@@ -295,10 +551,22 @@ int at_obj_get_urcbuf_count(at_obj_t *at);
 
 void at_obj_urc_set_enable(at_obj_t *at, int enable, unsigned short timeout);
 
+#if AT_URC_DEFER_EN
+bool at_obj_urc_defer_enable(at_obj_t *at, void (*notify)(at_obj_t *at));
+
+int at_obj_urc_dispatch(at_obj_t *at, int max);
+
+void at_obj_urc_get_stats(at_obj_t *at, at_urc_stats_t *stats);
+#endif
+
 #endif
 
 void at_obj_process(at_obj_t *at);
 
+unsigned int at_obj_next_deadline(at_obj_t *at);
+
+void at_obj_notify_rx(at_obj_t *at);
+
 void at_attr_deinit(at_attr_t *attr);
 
 bool at_exec_cmd(at_obj_t *at, const at_attr_t *attr, const char *cmd, ...);
@@ -317,6 +585,48 @@ bool at_do_work(at_obj_t *at,  void *params, at_work_t work);
 
 void at_work_abort_all(at_obj_t *at);
 
+#if AT_RESP_CACHE_EN
+void at_obj_cache_invalidate(at_obj_t *at, const char *cmd);
+
+void at_obj_cache_get_stats(at_obj_t *at, at_cache_stats_t *stats);
+#endif
+
+#if AT_ADAPTIVE_TIMEOUT_EN
+bool at_obj_get_rtt_stats(at_obj_t *at, const char *cmd, at_rtt_stats_t *stats);
+#endif
+
+#if AT_CQ_EN
+bool at_cq_init(at_cq_t *cq, at_cqe_t *entries, unsigned int count, void *databuf, unsigned int bufsize);
+
+bool at_obj_set_cq(at_obj_t *at, at_cq_t *cq);
+
+int at_cq_reap(at_obj_t *at, int max);
+#endif
+
+#if AT_TIMER_WHEEL_EN
+void at_wheel_init(at_wheel_t *w, unsigned int now);
+
+void at_timer_init(at_timer_t *t);
+
+bool at_timer_pending(const at_timer_t *t);
+
+void at_wheel_add(at_wheel_t *w, at_timer_t *t, unsigned int expires);
+
+void at_wheel_del(at_wheel_t *w, at_timer_t *t);
+
+void at_wheel_advance(at_wheel_t *w, unsigned int now, void (*expire)(at_timer_t *t, void *arg), void *arg);
+
+unsigned int at_wheel_next(const at_wheel_t *w, unsigned int now);
+
+void at_sched_init(at_sched_t *s, void (*lock)(void), void (*unlock)(void));
+
+void at_sched_add(at_sched_t *s, at_obj_t *at);
+
+void at_sched_remove(at_obj_t *at);
+
+unsigned int at_sched_poll(at_sched_t *s);
+#endif
+
 #if AT_MEM_WATCH_EN
 unsigned int at_max_used_memory(void);
 
@@ -335,6 +645,20 @@ bool at_work_is_finish(at_context_t *ctx);
 
 at_resp_code  at_work_get_result(at_context_t *ctx);
 
+#if AT_SYNC_EN
+
+bool at_context_sync_init(at_context_t *ctx, void *respbuf, unsigned bufsize);
+
+void at_context_sync_deinit(at_context_t *ctx);
+
+bool at_wait(at_context_t *ctx, unsigned int timeout);
+
+at_resp_code at_exec_cmd_sync(at_obj_t *at, const at_attr_t *attr, at_context_t *ctx, const char *cmd, ...);
+
+at_resp_code at_exec_vcmd_sync(at_obj_t *at, const at_attr_t *attr, at_context_t *ctx, const char *cmd, va_list va);
+
+#endif //End of AT_SYNC_EN
+
 #endif //End of AT_WORK_CONTEXT_EN
 
 #if AT_RAW_TRANSPARENT_EN
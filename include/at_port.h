@@ -32,15 +32,103 @@
  */
 #define AT_URC_TIMEOUT    500
 
+/**
+ *@brief Polling interval (ms) reported by at_obj_next_deadline while a custom work 
+ *       (at_do_work) or the transparent transmission is running.
+ */
+#define AT_WORK_POLL_INTERVAL 10
+
 /**
  *@brief Maximum AT command send data length (only for variable parameter commands).
  */
 #define AT_MAX_CMD_LEN    256     
 
+/**
+ *@brief Size of the chunk read from the adapter at a time (allocated on the stack of at_obj_process).
+ */
+#define AT_RECV_CHUNK_SIZE 128
+
+/**
+ *@brief Maximum number of bytes received in one at_obj_process call, the received data is 
+ *       drained chunk by chunk until there is no more data or the budget is used up.
+ */
+#define AT_RECV_BUDGET     2048
+
 /**
  *@brief Maximum number of work in queue (limit memory usage).
  */
 #define AT_LIST_WORK_COUNT 32     
+
+/**
+ *@brief Number of work queue priority levels (ref@at_cmd_priority), the priorities 
+ *       above the highest level are executed as the highest level.
+ */
+#define AT_PRIORITY_LEVELS 4
+
+/**
+ *@brief Enable command coalescing (ref@at_attr_t.coalesce), identical queued query 
+ *       commands are sent only once.
+ */
+#define AT_COALESCE_EN     0u
+
+/**
+ *@brief Enable the response cache (ref@at_attr_t.cache), the successful responses of 
+ *       idempotent queries are reused until they expire.
+ */
+#define AT_RESP_CACHE_EN   0u
+
+/**
+ *@brief Maximum number of cached responses of each AT object.
+ */
+#define AT_RESP_CACHE_ENTRIES 8
+
+/**
+ *@brief Maximum memory (commands + responses) used by the response cache of each AT object,
+ *       the least recently used responses are evicted first. The entries are counted in 
+ *       AT_MEM_LIMIT_SIZE.
+ */
+#define AT_RESP_CACHE_LIMIT   512
+
+/**
+ *@brief Enable the adaptive timeout (ref@at_attr_t.adaptive), the receive timeout is 
+ *       estimated from the smoothed response time and its variation of each command verb.
+ */
+#define AT_ADAPTIVE_TIMEOUT_EN 0u
+
+/**
+ *@brief Number of command verbs whose response time is tracked by each AT object.
+ */
+#define AT_RTT_SLOTS       8
+
+/**
+ *@brief Minimum and maximum adaptive timeout(ms).
+ */
+#define AT_RTO_MIN         100
+#define AT_RTO_MAX         30000
+
+/**
+ *@brief Enable the retry policy (ref@at_attr_t.retry_policy), the resending delay grows 
+ *       exponentially with random jitter, and error/timeout retries are counted separately.
+ */
+#define AT_RETRY_POLICY_EN 0u
+
+/**
+ *@brief Enable the work item pool, the finished work items are kept by size class 
+ *       and reused, so that submitting commands does not call at_malloc/at_free.
+ */
+#define AT_WORK_POOL_EN     1u
+
+/**
+ *@brief Maximum number of idle work items kept in each size class of the pool.
+ */
+#define AT_WORK_POOL_DEPTH  (AT_LIST_WORK_COUNT / 8)
+
+/**
+ *@brief Enable the lock-free submission queue, the requests are pushed to an atomic 
+ *       stack without calling the adapter lock, and moved to the work queues by 
+ *       at_obj_process (requires the GCC/Clang __atomic builtins).
+ */
+#define AT_LOCKFREE_SUBMIT_EN 0u
  
 /**
  *@brief Enable URC watcher.
@@ -51,13 +139,46 @@
  *@brief A list of specified URC end marks (fill in as needed, the fewer the better).
  */
 #define AT_URC_END_MARKS  ":,\n"
+
+/**
+ *@brief URC frames recognized by the URC table are not passed to the command response 
+ *       (unless they contain the response prefix of the running command), so that they
+ *       cannot cause false response matches. Set it to 0u to pass them to both (as V2.0).
+ */
+#define AT_URC_EXCLUSIVE_EN 1u
+
+/**
+ *@brief Enable the deferred URC queue (ref@at_obj_urc_defer_enable), the frames of the URC
+ *       items marked with 'defer' are queued and dispatched by at_obj_urc_dispatch instead 
+ *       of being handled in the receive path.
+ */
+#define AT_URC_DEFER_EN     0u
+
+/**
+ *@brief Maximum number of frames in the deferred URC queue (must be a power of 2).
+ */
+#define AT_URC_QUEUE_DEPTH  8
+
+/**
+ *@brief Data size of the deferred URC queue (must be a power of 2), reading is paused for 
+ *       at most AT_URC_STALL_TIME when it is 3/4 full, the frames that do not fit are dropped.
+ */
+#define AT_URC_QUEUE_SIZE   512
+
+/**
+ *@brief Maximum time(ms) the reading is paused while the deferred URC queue is almost full, 
+ *       it should be much shorter than the command timeouts.
+ */
+#define AT_URC_STALL_TIME   20
+
 /**
  *@brief Enable memory watcher.
  */
 #define AT_MEM_WATCH_EN     1u
   
 /**
- *@brief Maximum memory usage limit (Valid when AT_MEM_WATCH_EN is enabled)
+ *@brief Maximum memory usage limit (Valid when AT_MEM_WATCH_EN is enabled), it is shared by 
+ *       all AT objects, so raise it with the number of objects (e.g. when using groups).
  */
 #define AT_MEM_LIMIT_SIZE   (3 * 1024)
 
@@ -66,6 +187,32 @@
  */
 #define AT_WORK_CONTEXT_EN  1u
 
+/**
+ *@brief Enable the blocking interfaces (at_exec_cmd_sync/at_wait, OS environment only, 
+ *       AT_WORK_CONTEXT_EN must be enabled), the semaphore interfaces at_sem_xxx 
+ *       need to be implemented.
+ */
+#define AT_SYNC_EN          0u
+
+/**
+ *@brief Enable the completion queue (ref@at_obj_set_cq), the response callbacks can be 
+ *       dispatched by the application threads instead of the thread of at_obj_process.
+ */
+#define AT_CQ_EN            0u
+
+/**
+ *@brief Enable the hashed timer wheel (ref@at_wheel_t) and the scheduler (ref@at_sched_t), 
+ *       a thread can drive a large number of AT objects and only process the objects 
+ *       that have received data, submitted requests or reached their deadlines.
+ */
+#define AT_TIMER_WHEEL_EN   1u
+
+/**
+ *@brief Number of timer wheel slots (must be a power of 2, each slot covers 1ms), 
+ *       longer timeouts stay in the wheel for several rounds.
+ */
+#define AT_WHEEL_SLOTS      256
+
 /**
  * @brief Supports raw data transparent transmission
  */
@@ -77,4 +224,19 @@ void  at_free(void *ptr);
 
 unsigned int at_get_ms(void);
 
+#if AT_SYNC_EN
+/**
+ *@brief Semaphore handle (counting semaphore with an initial value of 0).
+ */
+typedef void *at_sem_t;
+
+at_sem_t at_sem_create(void);
+
+void at_sem_destroy(at_sem_t sem);
+
+int  at_sem_wait(at_sem_t sem, unsigned int timeout);
+
+void at_sem_post(at_sem_t sem);
+#endif
+
 #endif
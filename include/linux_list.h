@@ -18,7 +18,9 @@
  *
  */
 
-#if !defined(__GNUC__)
+#if defined(container_of)
+/* Defined by the application (it is included by at_chat.h) */
+#elif !defined(__GNUC__)
 #define container_of(ptr, type, member) ( \
 	(type *)( (char *)(ptr) - offsetof(type,member) ))
 #else
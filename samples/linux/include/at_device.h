@@ -7,6 +7,8 @@
 #ifndef __AT_DEVICE_H__
 #define __AT_DEVICE_H__
 
+#include "at_chat.h"
+
 void at_device_init(void);
 
 void at_device_open(void);
@@ -15,8 +17,12 @@ void at_device_close(void);
 
 unsigned int at_device_write(const void *buf, unsigned int size);
 
+unsigned int at_device_writev(const at_iovec_t *iov, int iovcnt);
+
 unsigned int at_device_read(void *buf, unsigned int size);
 
 void at_device_emit_urc(const void *urc, int size);
 
+int at_device_fd(void);
+
 #endif
@@ -0,0 +1,36 @@
+/******************************************************************************
+ * @brief    AT对象分组(多个AT对象分片到多个工作线程)
+ * @note     AT_MEM_LIMIT_SIZE为所有AT对象共享的内存限额, 需按分组内AT对象的数量调大
+ ******************************************************************************/
+#ifndef __AT_GROUP_H__
+#define __AT_GROUP_H__
+
+#include "at_chat.h"
+
+typedef struct at_group at_group_t;
+
+/**
+ * @brief 分组配置
+ */
+typedef struct {
+    /* 设备适配器(所有AT对象共享), 其中lock/unlock/wakeup由分组提供, 无需填写 */
+    const at_adapter_ex_t *adap;
+    int                    workers;         /* 工作线程数*/
+    const int             *cpus;            /* 每个工作线程绑定的CPU(workers个), NULL:不绑定*/
+} at_group_conf_t;
+
+at_group_t *at_group_create(const at_group_conf_t *conf);
+
+void at_group_destroy(at_group_t *g);
+
+at_obj_t *at_group_add(at_group_t *g, void *user_data, int fd);
+
+int at_group_count(at_group_t *g);
+
+at_obj_t *at_group_get(at_group_t *g, int index);
+
+int at_group_start(at_group_t *g);
+
+void at_group_stop(at_group_t *g);
+
+#endif
@@ -0,0 +1,25 @@
+/******************************************************************************
+ * @brief    AT事件驱动运行器(基于epoll/eventfd/timerfd)
+ ******************************************************************************/
+#ifndef __AT_REACTOR_H__
+#define __AT_REACTOR_H__
+
+#include "at_chat.h"
+
+typedef struct at_reactor at_reactor_t;
+
+at_reactor_t *at_reactor_create(void);
+
+void at_reactor_destroy(at_reactor_t *r);
+
+int at_reactor_add(at_reactor_t *r, at_obj_t *obj, int fd);
+
+void at_reactor_notify(at_reactor_t *r, int id);
+
+void at_reactor_wakeup(at_reactor_t *r);
+
+int at_reactor_run(at_reactor_t *r);
+
+void at_reactor_stop(at_reactor_t *r);
+
+#endif
@@ -25,8 +25,10 @@ extern "C" {
  * @member:	the name of the member within the struct.
  *
  */
+#ifndef container_of
 #define container_of(ptr, type, member) ( \
 	(type *)( (char *)(ptr) - offsetof(type,member) ))
+#endif
 
 
 #if defined(__CC_ARM) || defined(__GNUC__) /* ARM,GCC*/
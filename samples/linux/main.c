@@ -7,6 +7,7 @@
 #include "at_chat.h"
 #include "at_port.h"
 #include "at_device.h"
+#include "at_reactor.h"
 #include <sys/poll.h>
 #include <fcntl.h>
 #include <unistd.h>
@@ -19,6 +20,7 @@
 
 static at_obj_t       *at_obj;      //AT
 static pthread_mutex_t at_lock;     //互斥锁
+static at_reactor_t   *at_reactor;  //事件驱动运行器
 
 typedef struct {
     pthread_mutex_t completed;      //完成信号量
@@ -48,6 +50,14 @@ static void at_mutex_unlock(void)
     pthread_mutex_unlock(&at_lock);
 }
 
+/**
+ * @brief 唤醒AT处理线程(有新的请求提交)
+ */
+static void at_wakeup(void)
+{
+    at_reactor_wakeup(at_reactor);
+}
+
 /**
  * @brief 命令异常处理
  */
@@ -423,6 +433,20 @@ static at_resp_code at_send_cmd_sync(char *respbuf, int bufsize, int timeout, co
     at_attr_t    attr;
     at_context_t ctx;
     va_list      args; 
+#if AT_SYNC_EN
+    at_resp_code code;
+    //属性初始化
+    at_attr_deinit(&attr);
+    attr.timeout = timeout;
+    attr.retry   = 1;
+    //初始化context
+    at_context_init(&ctx, respbuf, bufsize); 
+    //执行命令并阻塞等待完成(完成时由信号量唤醒)
+    va_start(args, cmd);
+    code = at_exec_vcmd_sync(at_obj, &attr, &ctx, cmd, args);
+    va_end(args);
+    return code;
+#else
     bool         ret;
     //属性初始化
     at_attr_deinit(&attr);
@@ -446,6 +470,7 @@ static at_resp_code at_send_cmd_sync(char *respbuf, int bufsize, int timeout, co
         usleep(1000);
     }    
     return at_work_get_result(&ctx);
+#endif
 }
 
 /**
@@ -530,7 +555,9 @@ static const at_adapter_t at_adapter = {
     .lock          = at_mutex_lock,
     .unlock        = at_mutex_unlock,
     .write         = at_device_write,
+    .writev        = at_device_writev,
     .read          = at_device_read,    
+    .wakeup        = at_wakeup,
     .error         = at_error_handler,
     .debug         = at_debug,
 #if AT_URC_WARCH_EN    
@@ -546,16 +573,18 @@ static void *at_thread(void *args)
 {
     pthread_detach(pthread_self());
     printf("at thread running...\r\n");    
-    while(1) {
-        usleep(1000);
-        at_obj_process(at_obj);
-    }
+    at_reactor_run(at_reactor);                     //阻塞等待数据/请求/超时事件
     return NULL;
 }
 
 int main(int argc, char **argv)
 {
     pthread_t     tid;
+    at_reactor = at_reactor_create();
+    if (at_reactor == NULL) {
+        printf("at reactor create failed\r\n");
+        _exit(0);
+    }
     at_obj = at_obj_create(&at_adapter);
     if (at_obj == NULL) {
         printf("at object create failed\r\n");
@@ -563,6 +592,7 @@ int main(int argc, char **argv)
     }     
     at_obj_set_urc(at_obj, urc_table,  sizeof(urc_table) / sizeof(urc_table[0]) );
     at_device_init();
+    at_reactor_add(at_reactor, at_obj, at_device_fd());
     pthread_mutex_init(&at_lock, NULL);
     pthread_create(&tid, NULL, at_thread, NULL); 
     printf("*******************************************************\r\n");
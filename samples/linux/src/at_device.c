@@ -15,6 +15,8 @@
 #include <fcntl.h>
 #include <sys/poll.h>
 #include <sys/stat.h>
+#include <sys/eventfd.h>
+#include <stdint.h>
 #include <pthread.h>
 
 /**
@@ -26,16 +28,42 @@ typedef struct {
     ring_buf_t    rb_rx; 
     unsigned char txbuf[1024];
     unsigned char rxbuf[512];
+    int           tx_event;            /* 设备有数据待AT对象读取(rb_tx非空)*/
+    int           rx_event;            /* AT对象写入了数据(rb_rx非空)*/
 } at_device_t;
 
 static at_device_t at_device;
 
+/**
+ * @brief 触发事件
+ */
+static void event_signal(int fd)
+{
+    uint64_t val = 1;
+    if (write(fd, &val, sizeof(val)) < 0) {
+        /* 计数溢出(EAGAIN)时事件已处于触发状态 */
+    }
+}
+
+/**
+ * @brief 清除事件
+ */
+static void event_clear(int fd)
+{
+    uint64_t val;
+    if (read(fd, &val, sizeof(val)) < 0) {
+        /* 事件未触发(EAGAIN) */
+    }
+}
+
 /**
  * @brief 数据写操作
  */
 static unsigned int cli_write(const void *buf, unsigned int size)
 {
-    return ring_buf_put(&at_device.rb_tx, (unsigned char *)buf, size);
+    unsigned int len = ring_buf_put(&at_device.rb_tx, (unsigned char *)buf, size);
+    event_signal(at_device.tx_event);
+    return len;
 }
 /**
  * @brief 数据读操作
@@ -51,10 +79,13 @@ static unsigned int cli_read(void *buf, unsigned int size)
 static void *at_device_thread(void *args)
 {
     pthread_detach(pthread_self());
+    struct pollfd pfd = {.fd = at_device.rx_event, .events = POLLIN};
     printf("at devicce running...\r\n");    
     while(1) {
-        usleep(1000);
-        cli_process(&at_device.cli);
+        poll(&pfd, 1, -1);                          /*等待AT对象写入数据 */
+        event_clear(at_device.rx_event);
+        while (ring_buf_len(&at_device.rb_rx) > 0)
+            cli_process(&at_device.cli);
     }
     return NULL;
 }
@@ -69,6 +100,8 @@ void at_device_init(void)
     /*初始化环形缓冲区 */
     ring_buf_init(&at_device.rb_rx, at_device.rxbuf, sizeof(at_device.rxbuf));
     ring_buf_init(&at_device.rb_tx, at_device.txbuf, sizeof(at_device.txbuf));
+    at_device.tx_event = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    at_device.rx_event = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
 
     cli_init(&at_device.cli, &p);                   /*初始化命令行对象 */
     cli_enable(&at_device.cli);
@@ -85,8 +118,26 @@ void at_device_init(void)
  */
 unsigned int at_device_write(const void *buf, unsigned int size)
 {
-    return ring_buf_put(&at_device.rb_rx, (unsigned char *)buf, size);
+    unsigned int len = ring_buf_put(&at_device.rb_rx, (unsigned char *)buf, size);
+    event_signal(at_device.rx_event);
+    return len;
 }
+/**
+ * @brief 数据批量写操作(一次写入多个数据块)
+ * @param iov    数据块列表
+ * @param iovcnt 数据块个数
+ * @retval 实际写入数据
+ */
+unsigned int at_device_writev(const at_iovec_t *iov, int iovcnt)
+{
+    unsigned int size = 0;
+    int i;
+    for (i = 0; i < iovcnt; i++)
+        size += ring_buf_put(&at_device.rb_rx, (unsigned char *)iov[i].base, iov[i].len);
+    event_signal(at_device.rx_event);
+    return size;
+}
+
 /**
  * @brief 数据读操作
  * @param buf  数据缓冲区
@@ -95,7 +146,21 @@ unsigned int at_device_write(const void *buf, unsigned int size)
  */
 unsigned int at_device_read(void *buf, unsigned int size)
 {
-    return ring_buf_get(&at_device.rb_tx, buf, size);
+    unsigned int len = ring_buf_get(&at_device.rb_tx, buf, size);
+    if (len < size) {                                /*数据已读空, 清除可读事件 */
+        event_clear(at_device.tx_event);
+        if (ring_buf_len(&at_device.rb_tx) > 0)      /*清除事件期间又写入了数据 */
+            event_signal(at_device.tx_event);
+    }
+    return len;
+}
+
+/**
+ * @brief 获取设备可读事件的文件描述符(有数据待读取时可读, 用于epoll/poll)
+ */
+int at_device_fd(void)
+{
+    return at_device.tx_event;
 }
 
 /**
@@ -0,0 +1,242 @@
+/******************************************************************************
+ * @brief    AT对象分组(多个AT对象分片到多个工作线程)
+ *
+ *           分组创建并拥有N个AT对象, 它们共享同一个设备适配器(at_adapter_ex_t),
+ *           并被平均分配到M个工作线程上(每个工作线程由一个at_reactor驱动).
+ *           每个AT对象使用自己的互斥锁, 不同对象的请求提交互不影响, 工作线程
+ *           可以绑定到指定CPU上运行. 工作线程只处理有事件的对象(见at_reactor.c).
+ ******************************************************************************/
+#define _GNU_SOURCE
+#include "at_group.h"
+#include "at_reactor.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @brief 工作线程
+ */
+typedef struct {
+    at_reactor_t *reactor;
+    pthread_t     tid;
+    int           cpu;                  /* 绑定的CPU(-1:不绑定)*/
+    int           count;                /* 分配到此线程的AT对象个数*/
+    int           running;
+} group_worker_t;
+
+/**
+ * @brief 分组成员
+ */
+typedef struct {
+    at_adapter_ex_t  adap;              /* 对象专用适配器(必须为第一个成员, 用于由AT对象反查成员)*/
+    pthread_mutex_t  lock;              /* 对象锁*/
+    group_worker_t  *worker;            /* 所在工作线程*/
+    int              id;                /* 在工作线程运行器中的编号*/
+    at_obj_t        *obj;
+} group_member_t;
+
+/**
+ * @brief AT对象分组
+ */
+struct at_group {
+    const at_adapter_ex_t *adap;
+    group_worker_t        *workers;
+    int                    worker_count;
+    group_member_t       **members;
+    int                    count;
+    int                    capacity;
+    int                    running;
+};
+
+static inline group_member_t *member_map(at_obj_t *obj)
+{
+    return (group_member_t *)obj->adap_ex;
+}
+
+static void member_lock(at_obj_t *obj)
+{
+    pthread_mutex_lock(&member_map(obj)->lock);
+}
+
+static void member_unlock(at_obj_t *obj)
+{
+    pthread_mutex_unlock(&member_map(obj)->lock);
+}
+
+static void member_wakeup(at_obj_t *obj)
+{
+    at_reactor_notify(member_map(obj)->worker->reactor, member_map(obj)->id);
+}
+
+/**
+ * @brief 工作线程入口
+ */
+static void *worker_thread(void *args)
+{
+    group_worker_t *w = (group_worker_t *)args;
+    at_reactor_run(w->reactor);
+    return NULL;
+}
+
+/**
+ * @brief  创建AT对象分组
+ * @param  conf 分组配置
+ * @return 分组对象, 失败返回NULL
+ */
+at_group_t *at_group_create(const at_group_conf_t *conf)
+{
+    at_group_t *g;
+    int i;
+    if (conf->adap == NULL || conf->workers <= 0)
+        return NULL;
+    g = calloc(1, sizeof(at_group_t));
+    if (g == NULL)
+        return NULL;
+    g->adap         = conf->adap;
+    g->worker_count = conf->workers;
+    g->workers      = calloc(conf->workers, sizeof(group_worker_t));
+    if (g->workers == NULL) {
+        free(g);
+        return NULL;
+    }
+    for (i = 0; i < conf->workers; i++) {
+        g->workers[i].cpu     = conf->cpus != NULL ? conf->cpus[i] : -1;
+        g->workers[i].reactor = at_reactor_create();
+        if (g->workers[i].reactor == NULL) {
+            at_group_destroy(g);
+            return NULL;
+        }
+    }
+    return g;
+}
+
+/**
+ * @brief 销毁分组(先停止工作线程, 再销毁分组内所有的AT对象)
+ */
+void at_group_destroy(at_group_t *g)
+{
+    group_member_t *m;
+    int i;
+    if (g == NULL)
+        return;
+    at_group_stop(g);
+    for (i = 0; i < g->count; i++) {
+        m = g->members[i];
+        at_obj_destroy(m->obj);
+        pthread_mutex_destroy(&m->lock);
+        free(m);
+    }
+    for (i = 0; i < g->worker_count; i++)
+        at_reactor_destroy(g->workers[i].reactor);
+    free(g->members);
+    free(g->workers);
+    free(g);
+}
+
+/**
+ * @brief  创建AT对象并加入分组(需在at_group_start之前调用), 对象被分配到负载最小的工作线程.
+ * @param  user_data 设备上下文(ref@at_obj_get_user_data)
+ * @param  fd        设备文件描述符, 可读时唤醒工作线程处理该对象, 不需要时填-1
+ *                   (此时需在接收数据后调用at_obj_notify_rx唤醒).
+ * @return AT对象, 失败返回NULL
+ */
+at_obj_t *at_group_add(at_group_t *g, void *user_data, int fd)
+{
+    group_member_t **members;
+    group_member_t *m;
+    group_worker_t *w = &g->workers[0];
+    int i;
+    if (g->running)
+        return NULL;
+    if (g->count == g->capacity) {
+        members = realloc(g->members, (g->capacity + 16) * sizeof(group_member_t *));
+        if (members == NULL)
+            return NULL;
+        g->members   = members;
+        g->capacity += 16;
+    }
+    for (i = 1; i < g->worker_count; i++) {
+        if (g->workers[i].count < w->count)
+            w = &g->workers[i];
+    }
+    m = calloc(1, sizeof(group_member_t));
+    if (m == NULL)
+        return NULL;
+    m->adap        = *g->adap;
+    m->adap.lock   = member_lock;
+    m->adap.unlock = member_unlock;
+    m->adap.wakeup = member_wakeup;
+    m->worker      = w;
+    pthread_mutex_init(&m->lock, NULL);
+    m->obj = at_obj_create_ex(&m->adap, user_data);
+    if (m->obj == NULL || (m->id = at_reactor_add(w->reactor, m->obj, fd)) < 0) {
+        if (m->obj != NULL)
+            at_obj_destroy(m->obj);
+        pthread_mutex_destroy(&m->lock);
+        free(m);
+        return NULL;
+    }
+    w->count++;
+    g->members[g->count++] = m;
+    return m->obj;
+}
+
+/**
+ * @brief 获取分组内AT对象个数
+ */
+int at_group_count(at_group_t *g)
+{
+    return g->count;
+}
+
+/**
+ * @brief 获取分组内的AT对象(按加入的顺序)
+ */
+at_obj_t *at_group_get(at_group_t *g, int index)
+{
+    return index >= 0 && index < g->count ? g->members[index]->obj : NULL;
+}
+
+/**
+ * @brief  启动所有工作线程
+ * @return 0 - 成功, -1 - 失败(已启动的线程会被停止)
+ */
+int at_group_start(at_group_t *g)
+{
+    group_worker_t *w;
+    cpu_set_t cpuset;
+    int i;
+    if (g->running)
+        return 0;
+    g->running = 1;
+    for (i = 0; i < g->worker_count; i++) {
+        w = &g->workers[i];
+        if (pthread_create(&w->tid, NULL, worker_thread, w) != 0) {
+            at_group_stop(g);
+            return -1;
+        }
+        w->running = 1;
+        if (w->cpu >= 0) {
+            CPU_ZERO(&cpuset);
+            CPU_SET(w->cpu, &cpuset);
+            pthread_setaffinity_np(w->tid, sizeof(cpuset), &cpuset);
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief 停止所有工作线程(等待线程退出, 停止后不能再次启动)
+ */
+void at_group_stop(at_group_t *g)
+{
+    int i;
+    for (i = 0; i < g->worker_count; i++) {
+        if (g->workers[i].running) {
+            at_reactor_stop(g->workers[i].reactor);
+            pthread_join(g->workers[i].tid, NULL);
+            g->workers[i].running = 0;
+        }
+    }
+}
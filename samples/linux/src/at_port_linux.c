@@ -5,9 +5,15 @@
  * @Last Modified by: roger.luo
  * @Last Modified time: 2021-11-27
  */
+#include "at_port.h"
 #include <stddef.h>
 #include <stdlib.h>
 #include <sys/time.h>
+#if AT_SYNC_EN
+#include <semaphore.h>
+#include <errno.h>
+#include <time.h>
+#endif
 
 /**
  * @brief Custom malloc for AT component.
@@ -34,3 +40,59 @@ unsigned int at_get_ms(void)
     gettimeofday(&tv_now, NULL);
     return (tv_now.tv_sec * 1000000 + tv_now.tv_usec) / 1000;
 }
+
+#if AT_SYNC_EN
+/**
+ * @brief Create a semaphore (initial value 0).
+ */
+at_sem_t at_sem_create(void)
+{
+    sem_t *sem = malloc(sizeof(sem_t));
+    if (sem != NULL && sem_init(sem, 0, 0) != 0) {
+        free(sem);
+        sem = NULL;
+    }
+    return sem;
+}
+
+/**
+ * @brief Destroy a semaphore.
+ */
+void at_sem_destroy(at_sem_t sem)
+{
+    sem_destroy((sem_t *)sem);
+    free(sem);
+}
+
+/**
+ * @brief  Wait for a semaphore.
+ * @param  timeout Waiting time(ms), 0xFFFFFFFF means waiting forever.
+ * @return 0 - success, -1 - timeout
+ */
+int at_sem_wait(at_sem_t sem, unsigned int timeout)
+{
+    struct timespec ts;
+    int ret;
+    if (timeout == 0xFFFFFFFFu) {
+        while ((ret = sem_wait((sem_t *)sem)) != 0 && errno == EINTR) {}
+        return ret;
+    }
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec  += timeout / 1000;
+    ts.tv_nsec += (timeout % 1000) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+    while ((ret = sem_timedwait((sem_t *)sem, &ts)) != 0 && errno == EINTR) {}
+    return ret;
+}
+
+/**
+ * @brief Release a semaphore.
+ */
+void at_sem_post(at_sem_t sem)
+{
+    sem_post((sem_t *)sem);
+}
+#endif
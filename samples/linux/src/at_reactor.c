@@ -0,0 +1,317 @@
+/******************************************************************************
+ * @brief    AT事件驱动运行器(基于epoll/eventfd/timerfd)
+ *
+ *           由一个线程驱动一个或多个AT对象, 只有在以下事件发生时才执行at_obj_process:
+ *           1. 设备文件描述符可读(接收到数据);
+ *           2. eventfd被写入(提交了新的AT请求, 见at_reactor_notify/at_reactor_wakeup);
+ *           3. timerfd到期(由at_obj_next_deadline计算的下一个超时时间).
+ *           空闲时线程阻塞在epoll_wait上, 不再占用CPU.
+ *
+ *           有事件的AT对象被放入就绪列表, 超时时间由内核的时间轮(at_wheel_t, AT_TIMER_WHEEL_EN)管理, 每次循环
+ *           只处理就绪的对象, 开销与活动的对象个数成正比, 而不是对象总数.
+ ******************************************************************************/
+#include "at_reactor.h"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+
+#if !AT_TIMER_WHEEL_EN
+    #error "at_reactor requires AT_TIMER_WHEEL_EN"
+#endif
+
+#define REACTOR_MAX_EVENTS 32
+
+/**
+ * @brief 运行器管理的AT对象
+ */
+typedef struct {
+    at_obj_t     *obj;
+    int           fd;                   /* 可读时唤醒的文件描述符(-1:无)*/
+    at_timer_t    timer;                /* 超时定时器(由at_obj_next_deadline设置)*/
+    int           notify_next;          /* 通知栈中的下一个对象(下标+1, 0:无)*/
+    unsigned char ready;                /* 已在就绪列表中*/
+    unsigned char notified;             /* 已在通知栈中(原子访问)*/
+} reactor_item_t;
+
+/**
+ * @brief AT运行器
+ */
+struct at_reactor {
+    int             epfd;
+    int             evfd;               /* 唤醒事件(提交请求/停止)*/
+    int             tmfd;               /* 超时定时器*/
+    volatile int    stop;               /* 停止标志*/
+    int             wake_all;           /* 需要检查所有对象(原子访问, 见at_reactor_wakeup)*/
+    int             notify_head;        /* 通知栈栈顶(下标+1, 0:空, 原子访问)*/
+    int             count;              
+    int             capacity;
+    reactor_item_t *items;
+    int            *ready;              /* 就绪列表(2*capacity, 处理过程中已处理的对象可能被再次加入)*/
+    int             ready_cnt;
+    at_wheel_t      wheel;              /* 超时时间轮*/
+};
+
+/**
+ * @brief epoll事件标识(AT对象使用 REACTOR_EV_ITEM + reactor_item_t下标)
+ */
+#define REACTOR_EV_WAKEUP  0
+#define REACTOR_EV_TIMER   1
+#define REACTOR_EV_ITEM    2
+
+static int reactor_watch(at_reactor_t *r, int fd, uint64_t tag)
+{
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events   = EPOLLIN;
+    ev.data.u64 = tag;
+    return epoll_ctl(r->epfd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+/**
+ * @brief 写eventfd唤醒运行线程
+ */
+static void reactor_kick(at_reactor_t *r)
+{
+    uint64_t val = 1;
+    if (write(r->evfd, &val, sizeof(val)) < 0) {
+        /* 计数溢出(EAGAIN)时运行器已处于唤醒状态 */
+    }
+}
+
+/**
+ * @brief 读取并清除eventfd/timerfd计数
+ */
+static void reactor_drain(int fd)
+{
+    uint64_t val;
+    if (read(fd, &val, sizeof(val)) < 0) {
+        /* 没有计数可读(EAGAIN) */
+    }
+}
+
+/**
+ * @brief 设置超时定时器
+ * @param ms 超时时间, AT_WAIT_FOREVER则停止定时器
+ */
+static void reactor_arm_timer(at_reactor_t *r, unsigned int ms)
+{
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    if (ms != AT_WAIT_FOREVER) {
+        its.it_value.tv_sec  = ms / 1000;
+        its.it_value.tv_nsec = (ms % 1000) * 1000000L;
+    }
+    timerfd_settime(r->tmfd, 0, &its, NULL);
+}
+
+/**
+ * @brief 将对象加入就绪列表
+ */
+static void ready_push(at_reactor_t *r, int id)
+{
+    if (!r->items[id].ready) {
+        r->items[id].ready = 1;
+        r->ready[r->ready_cnt++] = id;
+    }
+}
+
+/**
+ * @brief 将通知栈中的对象转移到就绪列表
+ */
+static void notify_drain(at_reactor_t *r)
+{
+    int id, next;
+    if (__atomic_load_n(&r->notify_head, __ATOMIC_ACQUIRE) == 0)
+        return;
+    id = __atomic_exchange_n(&r->notify_head, 0, __ATOMIC_ACQUIRE);
+    while (id != 0) {
+        id--;
+        next = r->items[id].notify_next;               //清除标志后该对象可能被再次入栈
+        __atomic_store_n(&r->items[id].notified, 0, __ATOMIC_RELEASE);
+        ready_push(r, id);
+        id = next;
+    }
+}
+
+/**
+ * @brief 对象超时, 加入就绪列表
+ */
+static void timer_expire(at_timer_t *t, void *arg)
+{
+    at_reactor_t *r = (at_reactor_t *)arg;
+    ready_push(r, (reactor_item_t *)((char *)t - offsetof(reactor_item_t, timer)) - r->items);
+}
+
+/**
+ * @brief  创建AT运行器
+ * @return 运行器对象, 失败返回NULL
+ */
+at_reactor_t *at_reactor_create(void)
+{
+    at_reactor_t *r = calloc(1, sizeof(at_reactor_t));
+    if (r == NULL)
+        return NULL;
+    r->epfd = epoll_create1(EPOLL_CLOEXEC);
+    r->evfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    r->tmfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    at_wheel_init(&r->wheel, at_get_ms());
+    if (r->epfd < 0 || r->evfd < 0 || r->tmfd < 0 ||
+        reactor_watch(r, r->evfd, REACTOR_EV_WAKEUP) != 0 ||
+        reactor_watch(r, r->tmfd, REACTOR_EV_TIMER) != 0) {
+        at_reactor_destroy(r);
+        return NULL;
+    }
+    return r;
+}
+
+/**
+ * @brief 销毁AT运行器(需先停止运行, AT对象本身不会被销毁)
+ */
+void at_reactor_destroy(at_reactor_t *r)
+{
+    if (r == NULL)
+        return;
+    if (r->epfd >= 0)
+        close(r->epfd);
+    if (r->evfd >= 0)
+        close(r->evfd);
+    if (r->tmfd >= 0)
+        close(r->tmfd);
+    free(r->items);
+    free(r->ready);
+    free(r);
+}
+
+/**
+ * @brief  添加AT对象(需在at_reactor_run之前调用)
+ * @param  obj AT对象
+ * @param  fd  设备文件描述符, 可读时唤醒运行器处理该对象, 不需要时填-1
+ *             (此时需在接收数据后调用at_obj_notify_rx唤醒).
+ * @return 对象编号(用于at_reactor_notify), -1 - 失败
+ */
+int at_reactor_add(at_reactor_t *r, at_obj_t *obj, int fd)
+{
+    reactor_item_t *items;
+    int *ready;
+    int i, capacity = r->capacity + 8;
+    if (r->count == r->capacity) {
+        items = realloc(r->items, capacity * sizeof(reactor_item_t));
+        if (items == NULL)
+            return -1;
+        r->items = items;
+        ready = realloc(r->ready, 2 * capacity * sizeof(int));
+        if (ready == NULL)
+            return -1;
+        r->ready    = ready;
+        r->capacity = capacity;
+        for (i = 0; i < r->count; i++)                 //对象位置已改变
+            at_timer_init(&r->items[i].timer);
+    }
+    if (fd >= 0 && reactor_watch(r, fd, REACTOR_EV_ITEM + r->count) != 0)
+        return -1;
+    memset(&r->items[r->count], 0, sizeof(reactor_item_t));
+    r->items[r->count].obj      = obj;
+    r->items[r->count].fd       = fd;
+    at_timer_init(&r->items[r->count].timer);
+    ready_push(r, r->count);                           //首次运行时处理一次
+    return r->count++;
+}
+
+/**
+ * @brief 通知运行器处理指定的AT对象(线程安全, 可在at_adapter_ex_t.wakeup中调用)
+ * @param id 对象编号(at_reactor_add的返回值)
+ */
+void at_reactor_notify(at_reactor_t *r, int id)
+{
+    reactor_item_t *it = &r->items[id];
+    int head;
+    if (__atomic_exchange_n(&it->notified, 1, __ATOMIC_ACQ_REL))
+        return;                                        //已经在通知栈中
+    head = __atomic_load_n(&r->notify_head, __ATOMIC_RELAXED);
+    do {
+        it->notify_next = head;
+    } while (!__atomic_compare_exchange_n(&r->notify_head, &head, id + 1, true, 
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    reactor_kick(r);
+}
+
+/**
+ * @brief 唤醒运行器并检查所有的AT对象(线程安全, 可作为at_adapter_t.wakeup的实现),
+ *        对象较多时应使用at_reactor_notify.
+ */
+void at_reactor_wakeup(at_reactor_t *r)
+{
+    __atomic_store_n(&r->wake_all, 1, __ATOMIC_RELEASE);
+    reactor_kick(r);
+}
+
+/**
+ * @brief  运行AT运行器, 直到调用at_reactor_stop
+ * @return 0 - 正常退出, -1 - epoll错误
+ */
+int at_reactor_run(at_reactor_t *r)
+{
+    struct epoll_event events[REACTOR_MAX_EVENTS];
+    unsigned int now, wait;
+    int i, n, id;
+    while (!r->stop) {
+        notify_drain(r);
+        if (__atomic_load_n(&r->wake_all, __ATOMIC_ACQUIRE) && 
+            __atomic_exchange_n(&r->wake_all, 0, __ATOMIC_ACQUIRE)) {
+            for (i = 0; i < r->count; i++)
+                ready_push(r, i);
+        }
+        //到期的对象加入就绪列表
+        now = at_get_ms();
+        at_wheel_advance(&r->wheel, now, timer_expire, r);
+        //只处理就绪的对象, 并更新它们的下一次超时时间
+        n = r->ready_cnt;
+        for (i = 0; i < n; i++) {
+            id = r->ready[i];
+            r->items[id].ready = 0;
+            at_obj_process(r->items[id].obj);
+            wait = at_obj_next_deadline(r->items[id].obj);
+            if (wait == 0)
+                ready_push(r, id);
+            else if (wait == AT_WAIT_FOREVER)
+                at_wheel_del(&r->wheel, &r->items[id].timer);
+            else
+                at_wheel_add(&r->wheel, &r->items[id].timer, now + wait);
+        }
+        r->ready_cnt -= n;
+        memmove(r->ready, r->ready + n, r->ready_cnt * sizeof(int));
+        //计算等待时间
+        wait = r->ready_cnt > 0 ? 0 : at_wheel_next(&r->wheel, now);
+        if (wait != 0)
+            reactor_arm_timer(r, wait);
+        n = epoll_wait(r->epfd, events, REACTOR_MAX_EVENTS, wait == 0 ? 0 : -1);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        for (i = 0; i < n; i++) {
+            if (events[i].data.u64 == REACTOR_EV_WAKEUP)
+                reactor_drain(r->evfd);
+            else if (events[i].data.u64 == REACTOR_EV_TIMER)
+                reactor_drain(r->tmfd);
+            else
+                ready_push(r, events[i].data.u64 - REACTOR_EV_ITEM);
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief 停止AT运行器(线程安全), at_reactor_run将在处理完当前事件后返回
+ */
+void at_reactor_stop(at_reactor_t *r)
+{
+    r->stop = 1;
+    reactor_kick(r);
+}
@@ -166,7 +166,7 @@ static at_attr_t at_attr = {
     .cb = NULL,
     .timeout = 1200,
     .retry = 1,
-    .priority = 1,
+    .priority = AT_PRIORITY_HIGH,
 };
 
 /**
@@ -34,11 +34,14 @@
 #include <stdio.h>
 #include <stddef.h>
 
-#define AT_DEBUG(ai, fmt, args...)                 \
-    do                                             \
-    {                                              \
-        if (__get_adapter(ai)->debug)              \
-            __get_adapter(ai)->debug(fmt, ##args); \
+#define AT_DEBUG(ai, fmt, args...)                           \
+    do                                                       \
+    {                                                        \
+        if (__get_adapter_ex(ai) != NULL) {                  \
+            if (__get_adapter_ex(ai)->debug)                 \
+                __get_adapter_ex(ai)->debug(&(ai)->obj, fmt, ##args); \
+        } else if (__get_adapter(ai)->debug)                 \
+            __get_adapter(ai)->debug(fmt, ##args);           \
     } while (0)
 
 #if AT_LIST_WORK_COUNT < 2
@@ -48,7 +51,28 @@
 //Used to identify the validity of a work item.
 #define WORK_ITEM_TAG 0x2532
 
-#define AT_IS_TIMEOUT(start, time) (at_get_ms() - (start) > (time))
+#define AT_IS_TIMEOUT(ai, start, time) ((int)((ai)->now - (start)) > (int)(time))
+
+//Publish/observe the fields of at_context_t across threads.
+#if defined(__GNUC__)
+#define AT_LOAD_ACQUIRE(ptr)           __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+#define AT_STORE_RELEASE(ptr, val)     __atomic_store_n(ptr, val, __ATOMIC_RELEASE)
+#else
+#define AT_LOAD_ACQUIRE(ptr)           (*(ptr))
+#define AT_STORE_RELEASE(ptr, val)     (*(ptr) = (val))
+#endif
+
+#if AT_LOCKFREE_SUBMIT_EN
+#define AT_ATOMIC_LOAD(ptr)            __atomic_load_n(ptr, __ATOMIC_ACQUIRE)
+#define AT_ATOMIC_STORE(ptr, val)      __atomic_store_n(ptr, val, __ATOMIC_RELEASE)
+#define AT_ATOMIC_XCHG(ptr, val)       __atomic_exchange_n(ptr, val, __ATOMIC_ACQ_REL)
+#define AT_ATOMIC_CAS(ptr, old, val)   __atomic_compare_exchange_n(ptr, old, val, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED)
+#define AT_ATOMIC_ADD(ptr, val)        __atomic_fetch_add(ptr, val, __ATOMIC_RELAXED)
+#define AT_ATOMIC_SUB(ptr, val)        __atomic_fetch_sub(ptr, val, __ATOMIC_RELAXED)
+#endif
+
+//Waiting time before resending a command after an error response (ms).
+#define AT_RETRY_DELAY 100
 
 /**AT work type (corresponding to different state machine polling handler.) */
 typedef enum {
@@ -87,8 +111,16 @@ typedef struct {
     unsigned int      state : 3;       /* State of work */
     unsigned int      type  : 3;       /* Type of work */
     unsigned int      code  : 3;       /* Response code*/
-    unsigned int      life  : 6;       /* Life cycle countdown(s)*/
+    unsigned int      life  : 6;       /* Queue time to live(s), 0: none (ref@at_attr_t.ttl)*/
     unsigned int      dirty : 1;       /* Dirty flag*/
+    unsigned char     slab;            /* Pool size class + 1 (0: allocated from heap)*/
+    unsigned int      stamp;           /* Submission time(ms)*/
+#if AT_SYNC_EN
+    unsigned char     notify;          /* Post attr.ctx->sem when the work item is recycled*/
+#endif
+#if AT_COALESCE_EN
+    void             *waiter;          /* Next work coalesced into this one (ref@at_attr_t.coalesce)*/
+#endif
     union {
         const void *info;
         at_work_t work;                /* Custom work */
@@ -102,6 +134,84 @@ typedef struct {
     };
 } work_item_t;
 
+#if AT_URC_WARCH_EN
+/**
+ * @brief URC prefix index node (Aho-Corasick automaton, node 0 is the root).
+ */
+typedef struct {
+    unsigned short    child;            /* First child node (0: none)*/
+    unsigned short    sibling;          /* Next sibling node (0: none)*/
+    unsigned short    fail;             /* Failure link*/
+    unsigned short    output;           /* Next node on the failure chain that ends a prefix (0: none)*/
+    short             item;             /* Index of the URC item whose prefix ends here (-1: none)*/
+    char              ch;               
+} urc_node_t;
+
+#if AT_URC_DEFER_EN
+/**
+ * @brief Deferred URC frame record.
+ */
+typedef struct {
+    const urc_item_t *item;
+    unsigned int      data;             /* Position of the frame in the data ring*/
+    unsigned int      data_end;         /* End of the frame in the data ring (free running)*/
+    unsigned short    len;
+    unsigned char     status;           /* ref@urc_recv_status*/
+} urc_record_t;
+
+/**
+ * @brief Deferred URC queue (single producer: at_obj_process, single consumer: at_obj_urc_dispatch).
+ */
+typedef struct {
+    urc_record_t      rec[AT_URC_QUEUE_DEPTH];
+    unsigned int      head, tail;       /* Record ring position (free running)*/
+    unsigned int      data_head, data_tail;
+    unsigned int      stall_timer;      /* Time when the reading was paused*/
+    unsigned char     stalled;          
+    at_urc_stats_t    stats;            /* Each counter has a single writer and is stored with release*/
+    void            (*notify)(at_obj_t *at);
+    char              data[AT_URC_QUEUE_SIZE];
+} urc_queue_t;
+#endif
+#endif
+
+#if AT_ADAPTIVE_TIMEOUT_EN
+/**
+ * @brief Response time statistics of a command verb (Jacobson/Karels estimator).
+ */
+typedef struct {
+    unsigned int      srtt;             /* Smoothed response time(ms) x 8*/
+    unsigned int      rttvar;           /* Response time variation(ms) x 4*/
+    unsigned int      used;             /* Last used time(ms), for replacement*/
+    unsigned short    verb;             /* Hash of the command verb*/
+    unsigned char     backoff;          /* Timeout backoff shift, reset by a valid sample*/
+    unsigned char     valid;            
+} rtt_entry_t;
+#endif
+
+#if AT_RESP_CACHE_EN
+/**
+ * @brief Response cache entry.
+ */
+typedef struct {
+    struct list_head  node;
+    unsigned int      expires;          /* Expiration time(ms)*/
+    unsigned short    cmdlen;           
+    unsigned short    resplen;          
+    unsigned short    refs;             /* References of the callbacks being invoked*/
+    unsigned char     dead;             /* Removed from the cache, freed when 'refs' drops to 0*/
+    char              data[0];          /* Command + '\0' + response + '\0'*/
+} cache_entry_t;
+#endif
+
+#if AT_WORK_POOL_EN
+/**
+ * @brief Work item pool size classes (extended size of the work item).
+ */
+#define WORK_POOL_CLASSES 5
+static const unsigned short work_pool_class[WORK_POOL_CLASSES] = {0, 32, 64, 128, AT_MAX_CMD_LEN};
+#endif
+
 /**
  * @brief AT Object infomation.
  */
@@ -109,17 +219,22 @@ typedef struct {
     at_obj_t          obj;              /* Inherit at_obj*/   
     at_env_t          env;              /* Public work environment*/
     work_item_t      *cursor;           /* Currently running work*/
-    struct list_head  hlist, llist;     /* High and low priority queue*/
+    struct list_head  queue[AT_PRIORITY_LEVELS];   /* Work queue of each priority level*/
     struct list_head *clist;            /* Queue currently in use*/
+    unsigned int      now;              /* Time of the current processing pass (at_get_ms() is read once per pass)*/
     unsigned int      timer;            /* General purpose timer*/   
+    unsigned int      wait_time;        /* Timeout of the current receiving/retry state*/
     unsigned int      next_delay;       /* Next cycle delay time*/
     unsigned int      delay_timer;      /* Delay timer*/
     char             *recvbuf;          /* Command response receive buffer*/
+    char             *txbuf;            /* Transmit buffer of env->println (allocated on first use)*/
     char             *prefix;           /* Point to prefix match*/
     char             *suffix;           /* Point to suffix match*/
 #if AT_URC_WARCH_EN    
     const urc_item_t *urc_tbl;
     const urc_item_t *urc_item;         /* The currently matched URC item*/
+    urc_node_t       *urc_index;        /* URC prefix index (NULL: fall back to linear search)*/
+    unsigned short    urc_any;          /* Index of the first item with an empty prefix*/
     char             *urcbuf;           
     unsigned int      urc_timer;        
     unsigned short    urc_bufsize;      
@@ -127,11 +242,45 @@ typedef struct {
     unsigned short    urc_target;       /* The target data length of the current URC frame*/
     unsigned short    urc_tbl_size;    
     unsigned short    urc_disable_time;     
+    unsigned short    urc_resp_cnt;     /* Bytes of the current URC frame passed to the response buffer*/
+#if AT_URC_DEFER_EN
+    urc_queue_t      *urc_queue;        /* Deferred URC queue (NULL: handle all frames inline)*/
+#endif
 #endif    
+#if AT_WORK_POOL_EN
+    work_item_t      *pool[WORK_POOL_CLASSES];     /* Idle work items of each size class*/
+    unsigned char     pool_cnt[WORK_POOL_CLASSES]; 
+#endif
+#if AT_LOCKFREE_SUBMIT_EN
+    work_item_t      *inbox;            /* Submitted work items (lock-free LIFO stack, linked by node.next)*/
+    unsigned char     abort_req;        /* at_work_abort_all has been invoked*/
+#endif
+#if AT_CQ_EN
+    at_cq_t          *cq;               /* Completion queue (NULL: invoke the callbacks inline)*/
+    work_item_t      *cq_wait;          /* Completion not queued yet because the queue is full*/
+#endif
+#if AT_ADAPTIVE_TIMEOUT_EN
+    rtt_entry_t       rtt[AT_RTT_SLOTS];
+    rtt_entry_t      *rtt_cur;          /* Statistics of the command being executed*/
+#endif
+#if AT_RETRY_POLICY_EN
+    unsigned char     retry_err;        /* Resends of the current command after error responses*/
+    unsigned char     retry_tmo;        /* Resends of the current command after timeouts*/
+    unsigned int      rand_seed;        /* Random state of the retry jitter*/
+#endif
+#if AT_RESP_CACHE_EN
+    struct list_head  cache;            /* Response cache (most recently used first)*/
+    at_cache_stats_t  cache_stats;      
+#endif
+#if AT_TIMER_WHEEL_EN
+    at_sched_t       *sched;            /* Scheduler that drives the object (NULL: none)*/
+    at_timer_t        sched_timer;      /* Deadline in the timer wheel of the scheduler*/
+    struct list_head  sched_node;       /* Node of the ready list of the scheduler*/
+#endif
     unsigned short    list_cnt;         
     unsigned short    recv_bufsize;     
     unsigned short    recv_cnt;         /* Command response receives counter*/
-    unsigned short    match_len;        /* Response information matching length*/
+    unsigned short    match_len;        /* Response length that has been scanned by the matcher*/
     unsigned char     match_mask;       /* Response information matching mask*/
     unsigned          urc_enable: 1;    
     unsigned          urc_match : 1;    
@@ -139,6 +288,9 @@ typedef struct {
     unsigned          disposing : 1;    
     unsigned          err_occur : 1;    
     unsigned          raw_trans : 1;
+    unsigned          urc_view  : 1;    /* The URC frame being received is the tail of the response buffer*/
+    unsigned          urc_shared: 1;    /* The claimed URC frame is also passed to the running work*/
+    volatile unsigned char rx_pending;  /* Data has been received (set by at_obj_notify_rx)*/
 } at_info_t;
 
 /**
@@ -151,12 +303,29 @@ static const at_attr_t at_def_attr = {
     .cb     = NULL,
     .timeout= AT_DEF_TIMEOUT,
     .retry  = AT_DEF_RETRY,
-    .priority = AT_PRIORITY_LOW
+    .priority = AT_PRIORITY_LOW,
+    .deadline = 0,
+    .ttl      = 0,
+#if AT_COALESCE_EN
+    .coalesce = 0
+#endif
 };
 /*Private static function declarations------------------------------------*/
 static void at_send_line(at_info_t *ai, const char *fmt, va_list args);
+static void resp_recv_process(at_info_t *ai, const char *buf, unsigned int size);
+#if AT_URC_WARCH_EN
+static void urc_frame_detach(at_info_t *ai);
+#endif
 static void *at_core_malloc(unsigned int nbytes);
 static void  at_core_free(void *ptr);
+#if AT_WORK_POOL_EN
+static bool  at_core_charge(void *ptr, bool force);
+static void  at_core_uncharge(void *ptr);
+#endif
+
+#if AT_URC_WARCH_EN
+static unsigned char urc_mark_map[256];  /* URC end mark classification table ('\0' is always an end mark)*/
+#endif
 
 #if AT_MEM_WATCH_EN 
 static unsigned int at_max_mem;          /* Maximum memory used*/
@@ -177,21 +346,88 @@ static inline const  at_adapter_t *__get_adapter(at_info_t *ai)
     return ai->obj.adap;
 }
 
+static inline const  at_adapter_ex_t *__get_adapter_ex(at_info_t *ai)
+{
+    return ai->obj.adap_ex;
+}
+
 static inline void at_lock(at_info_t *ai)
 {
-    if (__get_adapter(ai)->lock != NULL)
+    if (__get_adapter_ex(ai) != NULL) {
+        if (__get_adapter_ex(ai)->lock != NULL)
+            __get_adapter_ex(ai)->lock(&ai->obj);
+    } else if (__get_adapter(ai)->lock != NULL)
         __get_adapter(ai)->lock();
 }
 
 static inline void at_unlock(at_info_t *ai)
 {
-    if (__get_adapter(ai)->unlock != NULL)
+    if (__get_adapter_ex(ai) != NULL) {
+        if (__get_adapter_ex(ai)->unlock != NULL)
+            __get_adapter_ex(ai)->unlock(&ai->obj);
+    } else if (__get_adapter(ai)->unlock != NULL)
         __get_adapter(ai)->unlock();
 }
 
+#if AT_TIMER_WHEEL_EN
+/**
+ * @brief Add the object to the ready list of its scheduler.
+ */
+static void sched_ready(at_sched_t *s, at_info_t *ai)
+{
+    if (s->lock != NULL)
+        s->lock();
+    if (list_empty(&ai->sched_node))
+        list_add_tail(&ai->sched_node, &s->ready);
+    if (s->unlock != NULL)
+        s->unlock();
+}
+#endif
+
+static inline void at_wakeup(at_info_t *ai)
+{
+#if AT_TIMER_WHEEL_EN
+    if (ai->sched != NULL)
+        sched_ready(ai->sched, ai);
+#endif
+    if (__get_adapter_ex(ai) != NULL) {
+        if (__get_adapter_ex(ai)->wakeup != NULL)
+            __get_adapter_ex(ai)->wakeup(&ai->obj);
+    } else if (__get_adapter(ai)->wakeup != NULL)
+        __get_adapter(ai)->wakeup();
+}
+
+static inline unsigned int adap_read(at_info_t *ai, void *buf, unsigned int len)
+{
+    if (__get_adapter_ex(ai) != NULL)
+        return __get_adapter_ex(ai)->read(&ai->obj, buf, len);
+    return __get_adapter(ai)->read(buf, len);
+}
+
 static inline void send_data(at_info_t *at, const void *buf, unsigned int len)
 {
-    __get_adapter(at)->write(buf, len);
+    if (__get_adapter_ex(at) != NULL)
+        __get_adapter_ex(at)->write(&at->obj, buf, len);
+    else
+        __get_adapter(at)->write(buf, len);
+}
+
+/**
+ * @brief   Send data blocks (in one operation if the adapter supports 'writev').
+ */
+static void send_datav(at_info_t *at, const at_iovec_t *iov, int iovcnt)
+{
+    int i;
+    if (__get_adapter_ex(at) != NULL && __get_adapter_ex(at)->writev != NULL) {
+        __get_adapter_ex(at)->writev(&at->obj, iov, iovcnt);
+        return;
+    }
+    if (__get_adapter_ex(at) == NULL && __get_adapter(at)->writev != NULL) {
+        __get_adapter(at)->writev(iov, iovcnt);
+        return;
+    }
+    for (i = 0; i < iovcnt; i++)
+        send_data(at, iov[i].base, iov[i].len);
 }
 
 /**
@@ -199,12 +435,14 @@ static inline void send_data(at_info_t *at, const void *buf, unsigned int len)
  */
 static void send_cmdline(at_info_t *at, const char *cmd)
 {
-    int len;
+    at_iovec_t iov[2];
     if (cmd == NULL)
         return;
-    len = strlen(cmd);
-    __get_adapter(at)->write(cmd, len);
-    __get_adapter(at)->write("\r\n", 2);
+    iov[0].base = cmd;
+    iov[0].len  = strlen(cmd);
+    iov[1].base = "\r\n";
+    iov[1].len  = 2;
+    send_datav(at, iov, 2);
     AT_DEBUG(at,"->\r\n%s", cmd);
 }
 
@@ -229,10 +467,23 @@ static char *get_recvbuf(at_env_t *env)
     return obj_map(env->obj)->recvbuf;
 }
 
+/**
+ * @brief  Reset the response buffer (the matcher restarts from the beginning).
+ */
+static void recv_reset(at_info_t *ai)
+{
+#if AT_URC_WARCH_EN
+    urc_frame_detach(ai);
+    ai->urc_resp_cnt = 0;
+#endif
+    ai->recvbuf[0] = '\0';
+    ai->recv_cnt   = 0;
+    ai->match_len  = 0;
+}
+
 static void recvbuf_clear(at_env_t *env)
 {
-    obj_map(env->obj)->recvbuf[0] = '\0';
-    obj_map(env->obj)->recv_cnt = 0;
+    recv_reset(obj_map(env->obj));
 }
 
 static char *find_substr(at_env_t *env, const char *str)
@@ -256,7 +507,7 @@ static bool at_isabort(at_env_t *env)
  */
 static bool at_is_timeout(at_env_t *env, unsigned int ms)
 {
-    return AT_IS_TIMEOUT(obj_map(env->obj)->timer, ms);
+    return AT_IS_TIMEOUT(obj_map(env->obj), obj_map(env->obj)->timer, ms);
 }
 
 
@@ -265,14 +516,15 @@ static bool at_is_timeout(at_env_t *env, unsigned int ms)
  */
 static void at_reset_timer(at_env_t *env)
 {
-    obj_map(env->obj)->timer = at_get_ms();
+    obj_map(env->obj)->timer = obj_map(env->obj)->now;
 }
 /**
  * @brief  Set the next poll wait time for the current work.
  */
 static void at_next_wait(struct at_env *env, unsigned int ms)
 {
-    obj_map(env->obj)->next_delay = ms;
+    obj_map(env->obj)->next_delay  = ms;
+    obj_map(env->obj)->delay_timer = obj_map(env->obj)->now;
     AT_DEBUG(obj_map(env->obj), "Next wait:%d\r\n", ms);
 }
 
@@ -283,8 +535,8 @@ static void update_work_state(work_item_t *wi, at_work_state state, at_resp_code
 #if AT_WORK_CONTEXT_EN
     at_context_t  *ctx = wi->attr.ctx;
     if (ctx != NULL) {
-        ctx->code       = (at_resp_code)wi->code;
-        ctx->work_state = (at_work_state)wi->state;
+        ctx->code = (at_resp_code)wi->code;
+        AT_STORE_RELEASE(&ctx->work_state, (at_work_state)wi->state);
     }
 #endif
 }
@@ -298,196 +550,1035 @@ static void at_finish(struct at_env *env, at_resp_code code)
     update_work_state(it, AT_WORK_STAT_FINISH, code);
 }
 
+#if AT_CQ_EN
 /**
- * @brief  AT execution callback handler.
+ * @brief  Push a completion record into the completion queue.
+ * @return false - the entry ring or the data ring is full.
  */
-static void do_at_callback(at_info_t *ai, work_item_t *wi, at_resp_code code)
-{
-    at_response_t r;
-    AT_DEBUG(ai, "<-\r\n%s", ai->recvbuf);
-    //Exception notification
-    if ((code == AT_RESP_ERROR || code == AT_RESP_TIMEOUT) && __get_adapter(ai)->error != NULL) {
-        __get_adapter(ai)->error(&r);
-        ai->err_occur = 1;
-        AT_DEBUG(ai, "AT Respose :%s", code == AT_RESP_TIMEOUT ? "timeout" : "error");
-    } else {
-        ai->err_occur = 0;
-    }
-#if AT_WORK_CONTEXT_EN
-    at_context_t  *ctx = wi->attr.ctx;
-    if (ctx != NULL ) {
-        if (ctx->respbuf != NULL/* && ctx->bufsize */) {
-            ctx->resplen = ai->recv_cnt >= ctx->bufsize ? ctx->bufsize - 1 : ai->recv_cnt;
-            memcpy(ctx->respbuf, ai->recvbuf, ctx->resplen);
-        }
+static bool cq_submit(at_cq_t *cq, at_callback_t cb, const at_response_t *r)
+{
+    at_cqe_t *e;
+    unsigned int head = cq->head;
+    unsigned int tail = AT_LOAD_ACQUIRE(&cq->tail);
+    unsigned int pos  = cq->data_head;
+    unsigned int need = r->recvcnt + 1;                     //Reserve the terminator
+    unsigned int off;
+    if (head - tail >= cq->entry_count)
+        goto overflow;
+    if (head == tail) {
+        //All the data has been released and the consumer does not touch data_tail until the 
+        //next entry is queued, rewind the data ring so that the whole ring is available.
+        cq->data_head = cq->data_tail = 0;
+        pos = 0;
     }
+    off = pos & (cq->data_size - 1);
+    if (off + need > cq->data_size)                         //The response is kept contiguous
+        pos += cq->data_size - off;
+    if (pos + need - AT_LOAD_ACQUIRE(&cq->data_tail) > cq->data_size)
+        goto overflow;
+    off = pos & (cq->data_size - 1);
+    memcpy(&cq->data[off], r->recvbuf, r->recvcnt);
+    cq->data[off + r->recvcnt] = '\0';
+    e = &cq->entries[head & (cq->entry_count - 1)];
+    e->cb       = cb;
+    e->params   = r->params;
+    e->code     = r->code;
+    e->recvcnt  = r->recvcnt;
+    e->prefix   = r->prefix - r->recvbuf;
+    e->suffix   = r->suffix - r->recvbuf;
+    e->data     = pos;
+    e->data_end = pos + need;
+    cq->data_head = pos + need;
+    AT_STORE_RELEASE(&cq->head, head + 1);
+    if (cq->notify != NULL)
+        cq->notify(cq);
+    return true;
+overflow:
+    cq->overflow++;
+    return false;
+}
 #endif
-    update_work_state(wi, AT_WORK_STAT_FINISH, code);
-    //Submit response data and status.
-    if (wi->attr.cb) {
-        r.obj     = &ai->obj;
-        r.params  = wi->attr.params;
-        r.recvbuf = ai->recvbuf;
-        r.recvcnt = ai->recv_cnt;
-        r.code    = code;        
-        r.prefix  = ai->prefix != NULL ? ai->prefix : ai->recvbuf;
-        r.suffix  = ai->suffix != NULL ? ai->suffix : ai->recvbuf;
-        wi->attr.cb(&r);
-    }
+
+/**
+ * @brief  Command line of the work (NULL: it is not a command line work).
+ */
+static inline const char *work_cmdline(const work_item_t *wi)
+{
+    if (wi->type == WORK_TYPE_CMD)
+        return wi->buf;
+    if (wi->type == WORK_TYPE_SINGLLINE)
+        return wi->singlline;
+    return NULL;
 }
 
+#if AT_RESP_CACHE_EN
+
 /**
- * @brief  Create a basic work item.
+ * @brief  Remove the entry from the cache (it is freed after the last reference is released). 
+ *         The adapter lock must be held.
  */
-static work_item_t *work_item_create(int extend_size)
+static void cache_remove(at_info_t *ai, cache_entry_t *e)
 {
-    work_item_t *it;
-    it = at_core_malloc(sizeof(work_item_t) + extend_size);   
-    if (it != NULL)
-        memset(it, 0, sizeof(work_item_t) + extend_size);
-    return it;
+    list_del(&e->node);
+    ai->cache_stats.entries--;
+    ai->cache_stats.bytes -= e->cmdlen + e->resplen + 2;
+    if (e->refs > 0)
+        e->dead = 1;
+    else
+        at_core_free(e);
 }
 
 /**
- * @brief  Destroy work item.
- * @param  it Pointer to an item to destroy.
+ * @brief  Find the entry of the command (the expired entries are removed). 
+ *         The adapter lock must be held.
  */
-static void work_item_destroy(work_item_t *it)
+static cache_entry_t *cache_find(at_info_t *ai, const char *cmd, unsigned int now)
 {
-    if (it != NULL) {
-        it->magic = 0;
-        at_core_free(it);
+    struct list_head *pos, *n;
+    cache_entry_t *e;
+    list_for_each_safe(pos, n, &ai->cache) {
+        e = list_entry(pos, cache_entry_t, node);
+        if ((int)(now - e->expires) >= 0)
+            cache_remove(ai, e);
+        else if (strcmp(e->data, cmd) == 0)
+            return e;
     }
+    return NULL;
 }
 
 /**
- * @brief Destroys all work items in the specified queue.
+ * @brief  Save the response of the finished work (ref@at_attr_t.cache).
  */
-static void work_item_destroy_all(at_info_t *ai, struct list_head *head)
+static void cache_store(at_info_t *ai, work_item_t *wi)
 {
-    struct list_head *pos, *n;
-    work_item_t *it;
+    const char *cmd = work_cmdline(wi);
+    cache_entry_t *e;
+    unsigned int cmdlen, size;
+    if (cmd == NULL)
+        return;
+    cmdlen = strlen(cmd);
+    size   = cmdlen + ai->recv_cnt + 2;
+    if (size > AT_RESP_CACHE_LIMIT)
+        return;
     at_lock(ai);
-    list_for_each_safe(pos, n, head) {
-        it = list_entry(pos, work_item_t, node);
-        list_del(&it->node);
-        work_item_destroy(it);
+    e = cache_find(ai, cmd, ai->now);
+    if (e != NULL)
+        cache_remove(ai, e);
+    //Evict the least recently used entries.
+    while (!list_empty(&ai->cache) && (ai->cache_stats.entries >= AT_RESP_CACHE_ENTRIES || 
+           ai->cache_stats.bytes + size > AT_RESP_CACHE_LIMIT))
+        cache_remove(ai, list_entry(ai->cache.prev, cache_entry_t, node));
+    e = at_core_malloc(sizeof(cache_entry_t) + size);
+    if (e != NULL) {
+        e->expires = ai->now + wi->attr.cache * 1000U;
+        e->cmdlen  = cmdlen;
+        e->resplen = ai->recv_cnt;
+        e->refs    = 0;
+        e->dead    = 0;
+        memcpy(e->data, cmd, cmdlen + 1);
+        memcpy(e->data + cmdlen + 1, ai->recvbuf, ai->recv_cnt);
+        e->data[size - 1] = '\0';
+        list_add(&e->node, &ai->cache);
+        ai->cache_stats.entries++;
+        ai->cache_stats.bytes += size;
     }
     at_unlock(ai);
 }
 
 /**
- * @brief  Work item recycling.
+ * @brief  Complete the command with the cached response (in the thread of the caller, the 
+ *         callback is queued instead if a completion queue is bound).
+ * @return true - cache hit, the callback has been invoked or queued.
  */
-static void work_item_recycle(at_info_t *ai, work_item_t *it)
+static bool cache_complete(at_info_t *ai, const at_attr_t *attr, const char *cmd)
 {
-    at_lock(ai);    
-    if (ai->list_cnt) 
-        ai->list_cnt--; 
-
-    list_del(&it->node);
-    work_item_destroy(it);
+    cache_entry_t *e;
+    at_response_t r;
+    if (attr == NULL || attr->cache == 0)
+        return false;
+    at_lock(ai);
+    e = cache_find(ai, cmd, at_get_ms());
+    if (e != NULL) {
+        r.recvbuf = e->data + e->cmdlen + 1;
+        r.prefix  = attr->prefix != NULL ? strstr(r.recvbuf, attr->prefix) : r.recvbuf;
+        if (r.prefix == NULL)
+            e = NULL;
+    }
+    if (e != NULL) {
+        r.obj     = &ai->obj;
+        r.params  = attr->params;
+        r.code    = AT_RESP_OK;
+        r.recvcnt = e->resplen;
+        r.suffix  = attr->suffix != NULL ? strstr(r.prefix, attr->suffix) : NULL;
+        if (r.suffix == NULL)
+            r.suffix = r.recvbuf;
+#if AT_CQ_EN
+        //If the completion queue is full, the command is sent as a miss (ref@work_complete).
+        if (ai->cq != NULL && attr->cb != NULL && !cq_submit(ai->cq, attr->cb, &r))
+            e = NULL;
+#endif
+    }
+    if (e == NULL) {
+        ai->cache_stats.misses++;
+        at_unlock(ai);
+        return false;
+    }
+    e->refs++;
+    list_move(&e->node, &ai->cache);
+    ai->cache_stats.hits++;
+    at_unlock(ai);
+#if AT_WORK_CONTEXT_EN
+    at_context_t *ctx = attr->ctx;
+    if (ctx != NULL) {
+        if (ctx->respbuf != NULL) {
+            ctx->resplen = r.recvcnt >= ctx->bufsize ? ctx->bufsize - 1 : r.recvcnt;
+            memcpy(ctx->respbuf, r.recvbuf, ctx->resplen);
+        }
+        ctx->code = AT_RESP_OK;
+        AT_STORE_RELEASE(&ctx->work_state, AT_WORK_STAT_FINISH);
+#if AT_SYNC_EN
+        if (ctx->sem != NULL)
+            at_sem_post(ctx->sem);
+#endif
+    }
+#endif
+#if AT_CQ_EN
+    if (ai->cq == NULL && attr->cb != NULL)
+#else
+    if (attr->cb != NULL)
+#endif
+        attr->cb(&r);
+    at_lock(ai);
+    if (--e->refs == 0 && e->dead)
+        at_core_free(e);
     at_unlock(ai);
+    return true;
 }
+#endif
+
 /**
- * @brief  Create and initialize a work item.
- * @param  type  Type of work item.
- * @param  attr  Item attributes
- * @param  info  additional information.
- * @param  size  the extended size.
+ * @brief  Finish the work with the response.
+ * @return false - the completion queue is full, the callback has not been dispatched.
  */
-static work_item_t *create_work_item(at_info_t *ai, int type, const at_attr_t *attr, const void *info, int extend_size)
+static bool work_complete(at_info_t *ai, work_item_t *wi, at_response_t *r)
 {
-    work_item_t *it = work_item_create(extend_size);
-    if (it == NULL) {
-        AT_DEBUG(ai, "Insufficient memory, list count:%d\r\n", ai->list_cnt);
-        return NULL;
-    }
-    if (ai->list_cnt > AT_LIST_WORK_COUNT) {
-        AT_DEBUG(ai, "Work queue full\r\n");
-        work_item_destroy(it);
-        return NULL;
+#if AT_WORK_CONTEXT_EN
+    at_context_t  *ctx = wi->attr.ctx;
+    if (ctx != NULL ) {
+        if (ctx->respbuf != NULL/* && ctx->bufsize */) {
+            ctx->resplen = ai->recv_cnt >= ctx->bufsize ? ctx->bufsize - 1 : ai->recv_cnt;
+            memcpy(ctx->respbuf, ai->recvbuf, ctx->resplen);
+        }
     }
-    if (attr == NULL)
-        attr = &at_def_attr;
-        
-    if (type == WORK_TYPE_CMD || type == WORK_TYPE_BUF) {
-        memcpy(it->buf, info, extend_size);
-        it->bufsize = extend_size;
-    } else {
-        it->info = info;
-    }        
-    it->magic = WORK_ITEM_TAG;
-    it->attr = *attr;
-    it->type = type;
-    it->state = AT_WORK_STAT_READY;
-#if AT_WORK_CONTEXT_EN    
-    if (attr->ctx) {
-        attr->ctx->code = AT_RESP_OK;
-        attr->ctx->work_state = AT_WORK_STAT_READY;
+#endif
+    update_work_state(wi, AT_WORK_STAT_FINISH, r->code);
+    //Submit response data and status.
+    if (wi->attr.cb) {
+#if AT_CQ_EN
+        if (ai->cq != NULL) {
+#if AT_RESP_CACHE_EN
+            bool ret;
+            at_lock(ai);                //Cache hits are queued by the submitting threads too.
+            ret = cq_submit(ai->cq, wi->attr.cb, r);
+            at_unlock(ai);
+            return ret;
+#else
+            return cq_submit(ai->cq, wi->attr.cb, r);
+#endif
+        }
+#endif
+        wi->attr.cb(r);
     }
-#endif    
-    return it;    
+    return true;
 }
 
-static work_item_t *sumit_work_item(at_info_t *ai, work_item_t *it)
+/**
+ * @brief  Finish the work and the works coalesced into it, starting from 'wi'.
+ */
+static void work_complete_all(at_info_t *ai, work_item_t *wi, at_response_t *r)
 {
-    if (it != NULL) {
-        at_lock(ai);
-        list_add_tail(&it->node, it->attr.priority == AT_PRIORITY_HIGH ? &ai->hlist : &ai->llist);         
-        ai->list_cnt++;  //Statistics
-        at_unlock(ai);
+    while (wi != NULL) {
+        r->params = wi->attr.params;
+        if (!work_complete(ai, wi, r)) {
+#if AT_CQ_EN
+            ai->cq_wait = wi;         //Retried by at_obj_process (ref@cq_retry).
+#endif
+            return;
+        }
+#if AT_COALESCE_EN
+        wi = wi->waiter;
+#else
+        wi = NULL;
+#endif
     }
-    return it;
 }
 
 /**
- * @brief  Create work and put it in the queue
- * @param  type  work of type
- * @param  attr  AT attributes
- * @param  info  Extra info
- * @param  size  Extra info size
+ * @brief  Build the response of the work from the response buffer.
  */
-static work_item_t *add_work_item(at_info_t *ai, int type, const at_attr_t *attr, const void *info, int extend_size)
+static void work_response(at_info_t *ai, work_item_t *wi, at_resp_code code, at_response_t *r)
 {
-    work_item_t *it = create_work_item(ai, type, attr, info, extend_size);
-    if (it == NULL)
-        return NULL;
-    return sumit_work_item(ai, it);
+    r->obj     = &ai->obj;
+    r->params  = wi->attr.params;
+    r->recvbuf = ai->recvbuf;
+    r->recvcnt = ai->recv_cnt;
+    r->code    = code;        
+    r->prefix  = ai->prefix != NULL ? ai->prefix : ai->recvbuf;
+    r->suffix  = ai->suffix != NULL ? ai->suffix : ai->recvbuf;
 }
 
 /**
- * @brief  Initialize matching info
+ * @brief  AT execution callback handler.
  */
-static void match_info_init(at_info_t *ai, at_attr_t *attr)
+static void do_at_callback(at_info_t *ai, work_item_t *wi, at_resp_code code)
 {
-    ai->prefix = ai->suffix = NULL;
-    ai->match_len = 0;
-    ai->match_mask = 0;        
-    if (attr->prefix == NULL || strlen(attr->prefix) == 0)
-        ai->match_mask |= MATCH_MASK_PREFIX;
-    if (attr->suffix == NULL || strlen(attr->suffix) == 0)
-        ai->match_mask |= MATCH_MASK_SUFFIX;
+    at_response_t r;
+    void (*error)(at_response_t *) = __get_adapter_ex(ai) != NULL ? __get_adapter_ex(ai)->error 
+                                                                  : __get_adapter(ai)->error;
+    AT_DEBUG(ai, "<-\r\n%s", ai->recvbuf);
+    work_response(ai, wi, code, &r);
+    //Exception notification
+    if ((code == AT_RESP_ERROR || code == AT_RESP_TIMEOUT) && error != NULL) {
+        error(&r);
+        ai->err_occur = 1;
+        AT_DEBUG(ai, "AT Respose :%s", code == AT_RESP_TIMEOUT ? "timeout" : "error");
+    } else {
+        ai->err_occur = 0;
+    }
+#if AT_RESP_CACHE_EN
+    if (code == AT_RESP_OK && wi->attr.cache != 0)
+        cache_store(ai, wi);
+#endif
+    //The coalesced works are completed from the same response.
+    work_complete_all(ai, wi, &r);
 }
 
+#if AT_CQ_EN
 /**
- * @brief Custom work processing 
+ * @brief  Queue the completions that did not fit into the completion queue again. Until 
+ *         then the running work is kept and the device is not read, so the response buffer
+ *         and the order of the completions are preserved (back pressure).
+ * @return true - Nothing is waiting for the completion queue.
  */
-static int do_work_handler(at_info_t *ai)
+static bool cq_retry(at_info_t *ai)
 {
-    work_item_t *i = ai->cursor;
-    if (ai->next_delay > 0) {
-        if (!AT_IS_TIMEOUT(ai->delay_timer, ai->next_delay))
-            return 0;
-        ai->next_delay = 0;
-    }    
-    return ((int (*)(at_env_t * e)) i->work)(&ai->env);
+    work_item_t *wi = ai->cq_wait;
+    at_response_t r;
+    if (wi == NULL)
+        return true;
+    ai->cq_wait = NULL;
+    work_response(ai, wi, (at_resp_code)wi->code, &r);
+    work_complete_all(ai, wi, &r);
+    return ai->cq_wait == NULL;
 }
+#endif
 
+#if AT_WORK_POOL_EN
+#if AT_LOCKFREE_SUBMIT_EN
 /**
- * @brief  Generic commands processing 
+ * @brief  Take an idle work item of the size class from the pool (NULL: empty).
+ *         The whole stack is taken at once and the rest is pushed back, so that
+ *         the concurrent pops are free of the ABA problem.
  */
-static int do_cmd_handler(at_info_t *ai)
+static work_item_t *work_pool_get(at_info_t *ai, int slab)
+{
+    work_item_t *it, *rest, *tail, *head;
+    if (AT_ATOMIC_LOAD(&ai->pool[slab]) == NULL)
+        return NULL;
+    it = AT_ATOMIC_XCHG(&ai->pool[slab], NULL);
+    if (it == NULL)
+        return NULL;
+    AT_ATOMIC_SUB(&ai->pool_cnt[slab], 1);
+    rest = (work_item_t *)it->node.next;
+    if (rest != NULL) {
+        for (tail = rest; tail->node.next != NULL; tail = (work_item_t *)tail->node.next) {}
+        head = AT_ATOMIC_LOAD(&ai->pool[slab]);
+        do {
+            tail->node.next = (struct list_head *)head;
+        } while (!AT_ATOMIC_CAS(&ai->pool[slab], &head, rest));
+    }
+    return it;
+}
+
+/**
+ * @brief  Keep an idle work item in the pool.
+ * @return false - The pool of its size class is full.
+ */
+static bool work_pool_put(at_info_t *ai, work_item_t *it)
+{
+    work_item_t *head;
+    int slab = it->slab - 1;
+    unsigned char cnt = AT_ATOMIC_LOAD(&ai->pool_cnt[slab]);
+    do {                                        //Reserve a slot before pushing.
+        if (cnt >= AT_WORK_POOL_DEPTH)
+            return false;
+    } while (!AT_ATOMIC_CAS(&ai->pool_cnt[slab], &cnt, (unsigned char)(cnt + 1)));
+    head = AT_ATOMIC_LOAD(&ai->pool[slab]);
+    do {
+        it->node.next = (struct list_head *)head;
+    } while (!AT_ATOMIC_CAS(&ai->pool[slab], &head, it));
+    return true;
+}
+
+/**
+ * @brief  Release all idle work items kept in the pool.
+ */
+static void work_pool_flush(at_info_t *ai)
+{
+    work_item_t *it, *next;
+    int i;
+    for (i = 0; i < WORK_POOL_CLASSES; i++) {
+        for (it = AT_ATOMIC_XCHG(&ai->pool[i], NULL); it != NULL; it = next) {
+            next = (work_item_t *)it->node.next;
+            AT_ATOMIC_SUB(&ai->pool_cnt[i], 1);
+            at_core_charge(it, true);
+            at_core_free(it);
+        }
+    }
+}
+#else
+/**
+ * @brief  Take an idle work item of the size class from the pool (NULL: empty).
+ */
+static work_item_t *work_pool_get(at_info_t *ai, int slab)
+{
+    work_item_t *it;
+    at_lock(ai);
+    if ((it = ai->pool[slab]) != NULL) {
+        ai->pool[slab] = (work_item_t *)it->node.next;
+        ai->pool_cnt[slab]--;
+    }
+    at_unlock(ai);
+    return it;
+}
+
+/**
+ * @brief  Keep an idle work item in the pool (the caller must hold the lock).
+ * @return false - The pool of its size class is full.
+ */
+static bool work_pool_put(at_info_t *ai, work_item_t *it)
+{
+    int slab = it->slab - 1;
+    if (ai->pool_cnt[slab] >= AT_WORK_POOL_DEPTH)
+        return false;
+    it->node.next = (struct list_head *)ai->pool[slab];
+    ai->pool[slab] = it;
+    ai->pool_cnt[slab]++;
+    return true;
+}
+
+/**
+ * @brief  Release all idle work items kept in the pool.
+ */
+static void work_pool_flush(at_info_t *ai)
+{
+    work_item_t *it;
+    int i;
+    at_lock(ai);
+    for (i = 0; i < WORK_POOL_CLASSES; i++) {
+        while ((it = ai->pool[i]) != NULL) {
+            ai->pool[i] = (work_item_t *)it->node.next;
+            at_core_charge(it, true);
+            at_core_free(it);
+        }
+        ai->pool_cnt[i] = 0;
+    }
+    at_unlock(ai);
+}
+#endif
+#endif
+
+/**
+ * @brief  Create a basic work item.
+ */
+static work_item_t *work_item_create(at_info_t *ai, int extend_size)
+{
+    work_item_t *it = NULL;
+    int slab = 0;
+#if AT_WORK_POOL_EN
+    while (slab < WORK_POOL_CLASSES && work_pool_class[slab] < extend_size)
+        slab++;
+    if (slab < WORK_POOL_CLASSES) {
+        it = work_pool_get(ai, slab);
+        if (it != NULL && !at_core_charge(it, false)) {    //The idle items are not charged to the limit.
+#if !AT_LOCKFREE_SUBMIT_EN
+            at_lock(ai);
+#endif
+            work_pool_put(ai, it);
+#if !AT_LOCKFREE_SUBMIT_EN
+            at_unlock(ai);
+#endif
+            return NULL;
+        }
+        if (it == NULL) {
+            it = at_core_malloc(sizeof(work_item_t) + work_pool_class[slab]);
+            if (it == NULL) {                  //Give the idle items back to the heap and try again.
+                work_pool_flush(ai);
+                it = at_core_malloc(sizeof(work_item_t) + work_pool_class[slab]);
+            }
+        }
+        slab++;
+    } else {
+        slab = 0;
+        it = at_core_malloc(sizeof(work_item_t) + extend_size);
+    }
+#else
+    it = at_core_malloc(sizeof(work_item_t) + extend_size);   
+#endif
+    if (it != NULL) {
+        memset(it, 0, sizeof(work_item_t) + extend_size);
+        it->slab = slab;
+    }
+    return it;
+}
+
+/**
+ * @brief  Destroy work item (the caller must hold the lock, unless AT_LOCKFREE_SUBMIT_EN
+ *         is enabled).
+ * @param  it Pointer to an item to destroy.
+ */
+static void work_item_destroy(at_info_t *ai, work_item_t *it)
+{
+    if (it != NULL) {
+        it->magic = 0;
+#if AT_WORK_POOL_EN
+        if (it->slab != 0) {
+            at_core_uncharge(it);
+            if (work_pool_put(ai, it))
+                return;
+            at_core_charge(it, true);
+        }
+#endif
+        at_core_free(it);
+    }
+}
+
+#if AT_SYNC_EN
+/**
+ * @brief  Wake up the thread waiting for the work item (ref@at_wait). 
+ *         It must be the last access to the context of the work item.
+ */
+static void work_item_notify(work_item_t *it)
+{
+    if (it->notify)
+        at_sem_post(it->attr.ctx->sem);
+}
+#endif
+
+#if AT_COALESCE_EN
+/**
+ * @brief  Release the works coalesced into the work item, the ones that have not been 
+ *         completed by the response (aborted, destroyed) end with the state of the work item.
+ * @return The number of works released.
+ */
+static int work_waiters_release(at_info_t *ai, work_item_t *it)
+{
+    work_item_t *w;
+    int n = 0;
+    while ((w = it->waiter) != NULL) {
+        it->waiter = w->waiter;
+        if (w->state < AT_WORK_STAT_FINISH) {
+            if (it->state < AT_WORK_STAT_FINISH)
+                update_work_state(w, AT_WORK_STAT_ABORT, AT_RESP_ABORT);
+            else
+                update_work_state(w, (at_work_state)it->state, (at_resp_code)it->code);
+        }
+#if AT_SYNC_EN
+        work_item_notify(w);
+#endif
+        work_item_destroy(ai, w);
+        n++;
+    }
+    return n;
+}
+
+static bool str_equal(const char *a, const char *b)
+{
+    return a == b || (a != NULL && b != NULL && strcmp(a, b) == 0);
+}
+
+/**
+ * @brief  Coalesce the work into an identical command that is waiting in the queue.
+ * @return true - the work has been attached to the waiting one.
+ */
+static bool work_coalesce(at_info_t *ai, struct list_head *head, work_item_t *it)
+{
+    struct list_head *pos;
+    work_item_t *wi;
+    if (!it->attr.coalesce || (it->type != WORK_TYPE_CMD && it->type != WORK_TYPE_SINGLLINE))
+        return false;
+    list_for_each(pos, head) {
+        wi = list_entry(pos, work_item_t, node);
+        if (wi == ai->cursor || wi->state != AT_WORK_STAT_READY || !wi->attr.coalesce ||
+            wi->type != it->type || !str_equal(wi->attr.prefix, it->attr.prefix) || 
+            !str_equal(wi->attr.suffix, it->attr.suffix) ||
+            wi->life != it->life || wi->attr.deadline != it->attr.deadline)
+            continue;                                   //The waiter shares the limits of the work.
+        if (it->type == WORK_TYPE_CMD ? wi->bufsize == it->bufsize && memcmp(wi->buf, it->buf, it->bufsize) == 0
+                                      : str_equal(wi->singlline, it->singlline)) {
+            while (wi->waiter != NULL)                  //Completed in submission order
+                wi = wi->waiter;
+            wi->waiter = it;
+            return true;
+        }
+    }
+    return false;
+}
+#endif
+
+/**
+ * @brief Work queue of the work item.
+ */
+static inline struct list_head *work_queue_of(at_info_t *ai, const work_item_t *it)
+{
+    unsigned int level = it->attr.priority;
+    return &ai->queue[level < AT_PRIORITY_LEVELS ? level : AT_PRIORITY_LEVELS - 1];
+}
+
+/**
+ * @brief Put the work item into its queue, the works with deadline are kept in 
+ *        earliest-deadline-first order ahead of the works without deadline.
+ */
+static void work_queue_insert(at_info_t *ai, work_item_t *it)
+{
+    struct list_head *head = work_queue_of(ai, it);
+    struct list_head *pos;
+    work_item_t *wi;
+#if AT_COALESCE_EN
+    if (work_coalesce(ai, head, it))
+        return;
+#endif
+    if (it->attr.deadline != 0) {
+        list_for_each(pos, head) {
+            wi = list_entry(pos, work_item_t, node);
+            if (wi->attr.deadline == 0 || 
+                (int)((it->stamp + it->attr.deadline) - (wi->stamp + wi->attr.deadline)) < 0)
+                break;
+        }
+        list_add_tail(&it->node, pos);  //Insert before 'pos'
+    } else {
+        list_add_tail(&it->node, head);
+    }
+}
+
+/**
+ * @brief Highest priority work queue that is not empty (NULL: all empty).
+ */
+static struct list_head *work_queue_pick(at_info_t *ai)
+{
+    int i;
+    for (i = AT_PRIORITY_LEVELS - 1; i >= 0; i--) {
+        if (!list_empty(&ai->queue[i]))
+            return &ai->queue[i];
+    }
+    return NULL;
+}
+
+/**
+ * @brief Abort all work items in the queues.
+ */
+static void work_queue_abort(at_info_t *ai)
+{
+    struct list_head *pos;
+    int i;
+    for (i = 0; i < AT_PRIORITY_LEVELS; i++) {
+        list_for_each(pos, &ai->queue[i]) {
+            update_work_state(list_entry(pos, work_item_t, node), AT_WORK_STAT_ABORT, AT_RESP_ABORT);
+        }
+    }
+}
+
+/**
+ * @brief Destroys all work items in the specified queue.
+ */
+static void work_item_destroy_all(at_info_t *ai, struct list_head *head)
+{
+    struct list_head *pos, *n;
+    work_item_t *it;
+    at_lock(ai);
+    list_for_each_safe(pos, n, head) {
+        it = list_entry(pos, work_item_t, node);
+        list_del(&it->node);
+#if AT_COALESCE_EN
+        work_waiters_release(ai, it);
+#endif
+#if AT_SYNC_EN
+        if (it->state < AT_WORK_STAT_FINISH)
+            update_work_state(it, AT_WORK_STAT_ABORT, AT_RESP_ABORT);
+        work_item_notify(it);
+#endif
+        work_item_destroy(ai, it);
+    }
+    at_unlock(ai);
+}
+
+/**
+ * @brief  Work item recycling.
+ */
+static void work_item_recycle(at_info_t *ai, work_item_t *it)
+{
+    int n = 1;
+#if AT_LOCKFREE_SUBMIT_EN
+    list_del(&it->node);                 //The work queues and waiters are only accessed by the engine.
+#if AT_COALESCE_EN
+    n += work_waiters_release(ai, it);
+#endif
+    AT_ATOMIC_SUB(&ai->list_cnt, n);
+    work_item_destroy(ai, it);
+#else
+    at_lock(ai);    
+#if AT_COALESCE_EN
+    n += work_waiters_release(ai, it);
+#endif
+    ai->list_cnt = ai->list_cnt > n ? ai->list_cnt - n : 0;
+
+    list_del(&it->node);
+    work_item_destroy(ai, it);
+    at_unlock(ai);
+#endif
+}
+/**
+ * @brief  Create and initialize a work item.
+ * @param  type  Type of work item.
+ * @param  attr  Item attributes
+ * @param  info  additional information (NULL: the buffer is filled by the caller).
+ * @param  size  the extended size.
+ */
+static work_item_t *create_work_item(at_info_t *ai, int type, const at_attr_t *attr, const void *info, int extend_size)
+{
+    work_item_t *it = work_item_create(ai, extend_size);
+    if (it == NULL) {
+        AT_DEBUG(ai, "Insufficient memory, list count:%d\r\n", AT_LOAD_ACQUIRE(&ai->list_cnt));
+        return NULL;
+    }
+    if (AT_LOAD_ACQUIRE(&ai->list_cnt) > AT_LIST_WORK_COUNT) {
+        AT_DEBUG(ai, "Work queue full\r\n");
+        at_lock(ai);
+        work_item_destroy(ai, it);
+        at_unlock(ai);
+        return NULL;
+    }
+    if (attr == NULL)
+        attr = &at_def_attr;
+        
+    if (type == WORK_TYPE_CMD || type == WORK_TYPE_BUF) {
+        if (info != NULL)
+            memcpy(it->buf, info, extend_size);
+        it->bufsize = extend_size;
+    } else {
+        it->info = info;
+    }        
+    it->magic = WORK_ITEM_TAG;
+    it->attr = *attr;
+    it->type = type;
+    it->state = AT_WORK_STAT_READY;
+    it->stamp = at_get_ms();
+    it->life  = attr->ttl < 63 ? attr->ttl : 63;
+#if AT_COALESCE_EN
+    it->waiter = NULL;
+#endif
+#if AT_WORK_CONTEXT_EN    
+    if (attr->ctx) {
+        attr->ctx->code = AT_RESP_OK;
+        AT_STORE_RELEASE(&attr->ctx->work_state, AT_WORK_STAT_READY);
+#if AT_SYNC_EN
+        it->notify = attr->ctx->sem != NULL;
+#endif
+    }
+#endif    
+    return it;    
+}
+
+static work_item_t *sumit_work_item(at_info_t *ai, work_item_t *it)
+{
+#if AT_LOCKFREE_SUBMIT_EN
+    work_item_t *head;
+#endif
+    if (it != NULL) {
+#if AT_LOCKFREE_SUBMIT_EN
+        AT_ATOMIC_ADD(&ai->list_cnt, 1);  //Count it before the engine can recycle it.
+        head = AT_ATOMIC_LOAD(&ai->inbox);
+        do {
+            it->node.next = (struct list_head *)head;
+        } while (!AT_ATOMIC_CAS(&ai->inbox, &head, it));
+#else
+        at_lock(ai);
+        work_queue_insert(ai, it);
+        ai->list_cnt++;  //Statistics
+        at_unlock(ai);
+#endif
+        at_wakeup(ai);
+    }
+    return it;
+}
+
+#if AT_LOCKFREE_SUBMIT_EN
+/**
+ * @brief  Move the submitted work items to the work queues (in submission order), 
+ *         and handle the pending abort request. Only invoked by the engine.
+ */
+static void work_inbox_drain(at_info_t *ai)
+{
+    work_item_t *it, *next, *fifo = NULL;
+    if (AT_ATOMIC_LOAD(&ai->inbox) != NULL) {
+        it = AT_ATOMIC_XCHG(&ai->inbox, NULL);
+        while (it != NULL) {             //Reverse the LIFO stack.
+            next = (work_item_t *)it->node.next;
+            it->node.next = (struct list_head *)fifo;
+            fifo = it;
+            it   = next;
+        }
+        while (fifo != NULL) {
+            next = (work_item_t *)fifo->node.next;
+            work_queue_insert(ai, fifo);
+            fifo = next;
+        }
+    }
+    if (AT_ATOMIC_LOAD(&ai->abort_req) && AT_ATOMIC_XCHG(&ai->abort_req, 0))
+        work_queue_abort(ai);
+}
+#endif
+
+/**
+ * @brief  Create work and put it in the queue
+ * @param  type  work of type
+ * @param  attr  AT attributes
+ * @param  info  Extra info
+ * @param  size  Extra info size
+ */
+static work_item_t *add_work_item(at_info_t *ai, int type, const at_attr_t *attr, const void *info, int extend_size)
+{
+    work_item_t *it = create_work_item(ai, type, attr, info, extend_size);
+    if (it == NULL)
+        return NULL;
+    return sumit_work_item(ai, it);
+}
+
+/**
+ * @brief  Initialize matching info
+ */
+static void match_info_init(at_info_t *ai, at_attr_t *attr)
+{
+    ai->prefix = ai->suffix = NULL;
+    ai->match_len = 0;
+    ai->match_mask = 0;        
+    if (attr->prefix == NULL || strlen(attr->prefix) == 0)
+        ai->match_mask |= MATCH_MASK_PREFIX;
+    if (attr->suffix == NULL || strlen(attr->suffix) == 0)
+        ai->match_mask |= MATCH_MASK_SUFFIX;
+}
+
+/**
+ * @brief  Resume a keyword search on the response buffer.
+ * @param  from    The earliest offset at which the keyword may start.
+ * @param  scanned The length of the response that was already searched, only 
+ *                 the newly appended bytes (plus strlen(str) - 1 bytes of overlap
+ *                 for a keyword spanning two reads) are searched again.
+ */
+static char *match_resume(at_info_t *ai, const char *str, unsigned int from, unsigned int scanned)
+{
+    unsigned int len = strlen(str);
+    if (scanned >= len && scanned - len + 1 > from)
+        from = scanned - len + 1;
+    return strstr(ai->recvbuf + from, str);
+}
+
+/**
+ * @brief  Match the prefix, suffix and error identifier incrementally, the state 
+ *         is kept in ai->prefix/suffix/match_mask between reads.
+ */
+static void match_process(at_info_t *ai, at_attr_t *attr)
+{
+    unsigned int scanned = ai->match_len;
+    unsigned int suffix_scanned = scanned;
+    if (scanned == ai->recv_cnt)
+        return;
+    ai->match_len = ai->recv_cnt;
+    //Matching response content prefix.
+    if (!(ai->match_mask & MATCH_MASK_PREFIX)) {
+        ai->prefix = match_resume(ai, attr->prefix, 0, scanned);
+        ai->match_mask |= ai->prefix ? MATCH_MASK_PREFIX : 0x00;
+        suffix_scanned = 0;            //The prefix has just been found, search the suffix from it.
+    }
+    //Matching response content suffix.
+    if (ai->match_mask & MATCH_MASK_PREFIX) {
+        if (!(ai->match_mask & MATCH_MASK_SUFFIX)) {
+            ai->suffix = match_resume(ai, attr->suffix, ai->prefix ? ai->prefix - ai->recvbuf : 0, 
+                                      suffix_scanned);
+            ai->match_mask |= ai->suffix ? MATCH_MASK_SUFFIX : 0x00;
+        } else if (ai->suffix == NULL) {
+            ai->suffix = ai->prefix ? ai->prefix : ai->recvbuf;
+        }
+    }
+    ai->match_mask |= match_resume(ai, AT_DEF_RESP_ERR, 0, scanned) ? MATCH_MASK_ERROR : 0x00;
+}
+
+/**
+ * @brief Custom work processing 
+ */
+static int do_work_handler(at_info_t *ai)
+{
+    work_item_t *i = ai->cursor;
+    if (ai->next_delay > 0) {
+        if (!AT_IS_TIMEOUT(ai, ai->delay_timer, ai->next_delay))
+            return 0;
+        ai->next_delay = 0;
+    }    
+    return ((int (*)(at_env_t * e)) i->work)(&ai->env);
+}
+
+#if AT_ADAPTIVE_TIMEOUT_EN
+/**
+ * @brief  Hash of the command verb and its form, the read ("AT+CREG?"), test ("AT+CREG=?"),
+ *         set ("AT+CREG=2") and execute ("AT+CREG", "ATD10086;") forms are measured apart.
+ */
+static unsigned short rtt_verb_hash(const char *cmd)
+{
+    unsigned int h = 2166136261U;                   //FNV-1a
+    unsigned int n;
+    char form;
+    if ((cmd[0] == 'A' || cmd[0] == 'a') && (cmd[1] == 'T' || cmd[1] == 't'))
+        cmd += 2;
+    if (((unsigned char)cmd[0] | 0x20) >= 'a' && ((unsigned char)cmd[0] | 0x20) <= 'z')
+        n = 1;                                      //Basic command
+    else
+        n = strcspn(cmd, "=?;\r\n");
+    while (n-- > 0)
+        h = (h ^ ((unsigned char)*cmd++ & ~0x20U)) * 16777619U;
+    if (cmd[0] == '=')
+        form = cmd[1] == '?' ? 'T' : 'S';
+    else
+        form = cmd[0] == '?' ? 'R' : 'E';
+    h = (h ^ (unsigned char)form) * 16777619U;
+    return (unsigned short)(h ^ (h >> 16));
+}
+
+/**
+ * @brief  Timeout estimated from the statistics: max(srtt + 4 * rttvar, AT_RTO_MIN) * 2^backoff.
+ */
+static unsigned int rtt_rto(const rtt_entry_t *e)
+{
+    unsigned int rto = (e->srtt >> 3) + e->rttvar;
+    if (rto < AT_RTO_MIN)
+        rto = AT_RTO_MIN;
+    rto <<= e->backoff;
+    return rto > AT_RTO_MAX ? AT_RTO_MAX : rto;
+}
+
+/**
+ * @brief  Get the receive timeout of the command from the response time statistics.
+ * @param  def  Timeout used until the response time of the command is measured.
+ */
+static unsigned int rtt_timeout(at_info_t *ai, const char *cmd, unsigned int def)
+{
+    rtt_entry_t *e, *victim = &ai->rtt[0];
+    unsigned short verb;
+    unsigned int rto;
+    int i;
+    ai->rtt_cur = NULL;
+    if (cmd == NULL)
+        return def;
+    verb = rtt_verb_hash(cmd);
+    at_lock(ai);
+    for (i = 0; i < AT_RTT_SLOTS; i++) {
+        e = &ai->rtt[i];
+        if (e->valid && e->verb == verb)
+            break;
+        if (!e->valid || (victim->valid && (int)(e->used - victim->used) < 0))
+            victim = e;
+    }
+    if (i == AT_RTT_SLOTS) {                        //Replace the least recently used one.
+        e = victim;
+        memset(e, 0, sizeof(rtt_entry_t));
+        e->verb = verb;
+    }
+    e->used     = ai->now;
+    ai->rtt_cur = e;
+    rto = e->valid ? rtt_rto(e) : def;
+    at_unlock(ai);
+    return rto;
+}
+
+/**
+ * @brief  Update the statistics with the response time of the current command.
+ * @param  resend  The command has been resent, the sample is ambiguous and discarded (Karn).
+ */
+static void rtt_sample(at_info_t *ai, bool resend)
+{
+    rtt_entry_t *e = ai->rtt_cur;
+    int delta, rtt = ai->now - ai->timer;
+    if (e == NULL || resend)
+        return;
+    at_lock(ai);
+    if (!e->valid) {
+        e->srtt   = rtt << 3;
+        e->rttvar = rtt << 1;
+        e->valid  = 1;
+    } else {
+        delta    = rtt - (int)(e->srtt >> 3);
+        e->srtt += delta;                           //srtt = 7/8 srtt + 1/8 rtt
+        if (delta < 0)
+            delta = -delta;
+        delta   -= (int)(e->rttvar >> 2);
+        e->rttvar += delta;                         //rttvar = 3/4 rttvar + 1/4 |err|
+    }
+    e->backoff  = 0;
+    at_unlock(ai);
+    ai->rtt_cur = NULL;
+}
+
+/**
+ * @brief  The current command timed out, double its next timeout.
+ */
+static void rtt_backoff(at_info_t *ai)
+{
+    at_lock(ai);
+    if (ai->rtt_cur != NULL && ai->rtt_cur->valid && ai->rtt_cur->backoff < 6)
+        ai->rtt_cur->backoff++;
+    at_unlock(ai);
+}
+#endif
+
+#if AT_RETRY_POLICY_EN
+/**
+ * @brief  Count a failed attempt of the current command and get the delay before resending.
+ * @param  timeout  The attempt failed by timeout, otherwise by an error response.
+ * @return Delay(ms) before resending, AT_WAIT_FOREVER: the retries are used up.
+ */
+static unsigned int retry_delay(at_info_t *ai, const at_retry_policy_t *policy, bool timeout)
+{
+    unsigned int delay = policy->base, cap = policy->cap ? policy->cap : 0xFFFF;
+    unsigned int n = ai->retry_err + ai->retry_tmo;
+    unsigned int x;
+    if (timeout) {
+        if (ai->retry_tmo >= policy->timeout_retry)
+            return AT_WAIT_FOREVER;
+        ai->retry_tmo++;
+    } else {
+        if (ai->retry_err >= policy->error_retry)
+            return AT_WAIT_FOREVER;
+        ai->retry_err++;
+    }
+    while (n-- > 0 && delay > 0 && delay < cap)
+        delay = delay * policy->multiplier / 100;
+    if (delay > cap)
+        delay = cap;
+    if (policy->jitter > 0 && delay > 0) {
+        x = ai->rand_seed;                          //xorshift32
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        ai->rand_seed = x;
+        delay -= (delay * (policy->jitter > 100 ? 100 : policy->jitter) / 100) * (x % 1024) / 1023;
+    }
+    return delay;
+}
+#endif
+
+/**
+ * @brief  Generic commands processing 
+ */
+static int do_cmd_handler(at_info_t *ai)
 {
     work_item_t *wi = ai->cursor;
     at_env_t   *env = &ai->env;
@@ -498,47 +1589,78 @@ static int do_cmd_handler(at_info_t *ai)
         if (wi->type == WORK_TYPE_CUSTOM && wi->sender != NULL) {
             wi->sender(env);
         } else if (wi->type == WORK_TYPE_BUF) {
-            __get_adapter(ai)->write(wi->buf, wi->bufsize);
+            send_data(ai, wi->buf, wi->bufsize);
         }  else if (wi->type == WORK_TYPE_SINGLLINE) {
             send_cmdline(ai, wi->singlline);
         } else {
             send_cmdline(ai, wi->buf);
         }
         env->state = AT_STAT_RECV;
+        ai->wait_time = attr->timeout;
+#if AT_ADAPTIVE_TIMEOUT_EN
+        if (attr->adaptive)
+            ai->wait_time = rtt_timeout(ai, work_cmdline(wi), attr->timeout);
+#endif
+#if AT_RETRY_POLICY_EN
+        if (env->i == 0)
+            ai->retry_err = ai->retry_tmo = 0;
+#endif
         env->reset_timer(env);
         env->recvclr(env);
         match_info_init(ai, attr);        
         break;
     case AT_STAT_RECV: /*Receive information and matching processing.*/
-        if (ai->match_len != ai->recv_cnt) {
-            ai->match_len = ai->recv_cnt;
-            //Matching response content prefix.
-            if ( !(ai->match_mask & MATCH_MASK_PREFIX) ) {
-                ai->prefix = strstr(ai->recvbuf, attr->prefix ? attr->prefix : "");
-                ai->match_mask |= ai->prefix ? MATCH_MASK_PREFIX : 0x00;
-            } 
-            //Matching response content suffix.
-            if ( ai->match_mask & MATCH_MASK_PREFIX ) {
-                ai->suffix = strstr(ai->prefix ? ai->prefix : ai->recvbuf, attr->suffix ? attr->suffix : "");
-                ai->match_mask |= ai->suffix ? MATCH_MASK_SUFFIX : 0x00;
-            }
-            ai->match_mask |= strstr(ai->recvbuf, AT_DEF_RESP_ERR) ? MATCH_MASK_ERROR : 0x00;
-        }
+        match_process(ai, attr);
+#if AT_ADAPTIVE_TIMEOUT_EN
+        if (attr->adaptive && (ai->match_mask & (MATCH_MASK_ERROR | MATCH_MASK_SUFFIX)))
+            rtt_sample(ai, env->i > 0);
+#endif
         if (ai->match_mask & MATCH_MASK_ERROR) {  
 			AT_DEBUG(ai, "<-\r\n%s\r\n", ai->recvbuf);
+#if AT_RETRY_POLICY_EN
+            if (attr->retry_policy != NULL) {
+                ai->wait_time = retry_delay(ai, attr->retry_policy, false);
+                if (ai->wait_time == AT_WAIT_FOREVER) {
+                    do_at_callback(ai, wi, AT_RESP_ERROR);
+                    return true;
+                }
+                env->i++;
+                env->state = AT_STAT_RETRY;
+                env->reset_timer(env);
+                break;
+            }
+#endif
             if (env->i++ >= attr->retry) {
                 do_at_callback(ai, wi, AT_RESP_ERROR);
                 return true;
             }
             
             env->state = AT_STAT_RETRY; //If the command responds incorrectly, it will wait for a while and try again.
+            ai->wait_time = AT_RETRY_DELAY;
             env->reset_timer(env); 
         }
         if (ai->match_mask & MATCH_MASK_SUFFIX) {
             do_at_callback(ai, wi, AT_RESP_OK);
             return true;
-        } else if (env->is_timeout(env, attr->timeout)) {
+        } else if (env->is_timeout(env, ai->wait_time)) {
 			AT_DEBUG(ai, "Command response timeout, retry:%d\r\n", env->i);
+#if AT_ADAPTIVE_TIMEOUT_EN
+            if (attr->adaptive)
+                rtt_backoff(ai);
+#endif
+#if AT_RETRY_POLICY_EN
+            if (attr->retry_policy != NULL) {
+                ai->wait_time = retry_delay(ai, attr->retry_policy, true);
+                if (ai->wait_time == AT_WAIT_FOREVER) {
+                    do_at_callback(ai, wi, AT_RESP_TIMEOUT);
+                    return true;
+                }
+                env->i++;
+                env->state = AT_STAT_RETRY;
+                env->reset_timer(env);
+                break;
+            }
+#endif
             if (env->i++ >= attr->retry) {
                 do_at_callback(ai, wi, AT_RESP_TIMEOUT);
                 return true;
@@ -547,7 +1669,7 @@ static int do_cmd_handler(at_info_t *ai)
         }
         break;        
     case AT_STAT_RETRY:
-        if (env->is_timeout(env, 100))
+        if (env->is_timeout(env, ai->wait_time))
             env->state = AT_STAT_SEND; /*Go back to the send state*/
         break;
     default:
@@ -575,12 +1697,25 @@ static int send_multiline_handler(at_info_t *ai)
         }
         send_cmdline(ai, cmds[env->i]);
         env->recvclr(env);         
+        ai->wait_time = AT_DEF_TIMEOUT;
+#if AT_ADAPTIVE_TIMEOUT_EN
+        if (attr->adaptive)
+            ai->wait_time = rtt_timeout(ai, cmds[env->i], AT_DEF_TIMEOUT);
+#endif
+#if AT_RETRY_POLICY_EN
+        if (env->j == 0)
+            ai->retry_err = ai->retry_tmo = 0;
+#endif
         env->reset_timer(env);
         env->state = AT_STAT_RECV;
         match_info_init(ai, attr);
         break;
     case AT_STAT_RECV:
         if (find_substr(env, attr->suffix)) {
+#if AT_ADAPTIVE_TIMEOUT_EN
+            if (attr->adaptive)
+                rtt_sample(ai, env->j > 0);
+#endif
             env->state = 0;
             env->i++;
             env->j = 0;
@@ -588,23 +1723,55 @@ static int send_multiline_handler(at_info_t *ai)
             AT_DEBUG(ai, "<-\r\n%s", ai->recvbuf);            
         } else if (find_substr(env, AT_DEF_RESP_ERR)) {
             AT_DEBUG(ai, "<-\r\n%s", ai->recvbuf);
+#if AT_ADAPTIVE_TIMEOUT_EN
+            if (attr->adaptive)
+                rtt_sample(ai, env->j > 0);
+#endif
             env->j++;
             AT_DEBUG(ai, "CMD:'%s' failed to executed, retry:%d", cmds[env->i], env->j);
+#if AT_RETRY_POLICY_EN
+            if (attr->retry_policy != NULL) {
+                ai->wait_time = retry_delay(ai, attr->retry_policy, false);
+                if (ai->wait_time == AT_WAIT_FOREVER) {
+                    env->state = 0;
+                    env->j = 0;
+                    env->i++;
+                } else {
+                    env->state = AT_STAT_RETRY;
+                    env->reset_timer(env);
+                }
+                break;
+            }
+#endif
             if (env->j >= attr->retry) {
                 env->state = 0;
                 env->j = 0;
                 env->i++;
             } else {
                 env->state = AT_STAT_RETRY;       //After the command responds incorrect, try again after a period of time.
+                ai->wait_time = AT_RETRY_DELAY;
                 env->reset_timer(env);                
             }
-        } else if (env->is_timeout(env, AT_DEF_TIMEOUT)) {
+        } else if (env->is_timeout(env, ai->wait_time)) {
+#if AT_ADAPTIVE_TIMEOUT_EN
+            if (attr->adaptive)
+                rtt_backoff(ai);
+#endif
+#if AT_RETRY_POLICY_EN
+            if (attr->retry_policy != NULL && 
+                (ai->wait_time = retry_delay(ai, attr->retry_policy, true)) != AT_WAIT_FOREVER) {
+                env->j++;
+                env->state = AT_STAT_RETRY;
+                env->reset_timer(env);
+                break;
+            }
+#endif
             do_at_callback(ai, wi, AT_RESP_TIMEOUT);
             return true;
         }
         break;
     case AT_STAT_RETRY:
-        if (env->is_timeout(env, 100))
+        if (env->is_timeout(env, ai->wait_time))
             env->state = AT_STAT_SEND;/*Go back to the send state and resend.*/
         break;
     default:
@@ -618,34 +1785,133 @@ static int send_multiline_handler(at_info_t *ai)
  */
 static void at_send_line(at_info_t *ai, const char *fmt, va_list args)
 {
+    at_iovec_t iov[2];
     int len;
-    char *cmdline;
-    cmdline = at_core_malloc(AT_MAX_CMD_LEN);
-    if (cmdline == NULL) {
-        AT_DEBUG(ai, "Malloc failed when send...\r\n");
-        return;
+    if (ai->txbuf == NULL) {
+        ai->txbuf = at_core_malloc(AT_MAX_CMD_LEN);
+        if (ai->txbuf == NULL) {
+            AT_DEBUG(ai, "Malloc failed when send...\r\n");
+            return;
+        }
     }
-    len = vsnprintf(cmdline, AT_MAX_CMD_LEN, fmt, args);
+    len = vsnprintf(ai->txbuf, AT_MAX_CMD_LEN, fmt, args);
+    if (len < 0)
+        return;
+    if (len >= AT_MAX_CMD_LEN)
+        len = AT_MAX_CMD_LEN - 1;
     //Clear receive buffer.
-    ai->recv_cnt = 0;
-    ai->recvbuf[0] = '\0';
-    send_data(ai, cmdline, len);
-    send_data(ai, "\r\n", 2);
-    AT_DEBUG(ai,"->\r\n%s\r\n", cmdline);
-
-    at_core_free(cmdline);
+    recv_reset(ai);
+    iov[0].base = ai->txbuf;
+    iov[0].len  = len;
+    iov[1].base = "\r\n";
+    iov[1].len  = 2;
+    send_datav(ai, iov, 2);
+    AT_DEBUG(ai,"->\r\n%s\r\n", ai->txbuf);
 }
 
 #if AT_URC_WARCH_EN
 
+/**
+ * @brief   Get the child of the URC index node that matches 'ch'.
+ */
+static unsigned short urc_index_goto(const urc_node_t *tbl, unsigned short node, char ch)
+{
+    for (node = tbl[node].child; node != 0; node = tbl[node].sibling) {
+        if (tbl[node].ch == ch)
+            return node;
+    }
+    return 0;
+}
+
+/**
+ * @brief   Build the URC prefix index (Aho-Corasick automaton) for the URC table.
+ * @return  The index, NULL if there is not enough memory.
+ * @note    The index lives as long as the URC table and grows with the total prefix length,
+ *          it is charged to AT_MEM_LIMIT_SIZE like the other buffers of the AT object.
+ */
+static urc_node_t *urc_index_build(const urc_item_t *tbl, int count)
+{
+    urc_node_t *nodes;
+    unsigned short *queue;
+    unsigned short node, next, fail;
+    const char *p;
+    int i, total = 1, head, tail;
+    for (i = 0; i < count; i++)
+        total += tbl[i].prefix ? strlen(tbl[i].prefix) : 0;
+    if (total > 0xFFFF)
+        return NULL;
+    nodes = at_core_malloc(total * sizeof(urc_node_t));
+    queue = at_core_malloc(total * sizeof(unsigned short));
+    if (nodes == NULL || queue == NULL) {
+        if (nodes != NULL)
+            at_core_free(nodes);
+        if (queue != NULL)
+            at_core_free(queue);
+        return NULL;
+    }
+    memset(nodes, 0, total * sizeof(urc_node_t));
+    nodes[0].item = -1;
+    //Build the prefix trie, the first item of the duplicate prefixes wins.
+    for (i = 0, total = 1; i < count; i++) {
+        if (tbl[i].prefix == NULL || *tbl[i].prefix == '\0')
+            continue;
+        for (node = 0, p = tbl[i].prefix; *p; node = next, p++) {
+            next = urc_index_goto(nodes, node, *p);
+            if (next == 0) {
+                next = total++;
+                nodes[next].ch      = *p;
+                nodes[next].item    = -1;
+                nodes[next].sibling = nodes[node].child;
+                nodes[node].child   = next;
+            }
+        }
+        if (nodes[node].item < 0)
+            nodes[node].item = i;
+    }
+    //Breadth-first traversal to build the failure and output links.
+    head = tail = 0;
+    for (node = nodes[0].child; node != 0; node = nodes[node].sibling)
+        queue[tail++] = node;
+    while (head < tail) {
+        node = queue[head++];
+        for (next = nodes[node].child; next != 0; next = nodes[next].sibling) {
+            queue[tail++] = next;
+            for (fail = nodes[node].fail; fail != 0 && urc_index_goto(nodes, fail, nodes[next].ch) == 0; )
+                fail = nodes[fail].fail;
+            fail = urc_index_goto(nodes, fail, nodes[next].ch);
+            nodes[next].fail   = fail;
+            nodes[next].output = nodes[fail].item >= 0 ? fail : nodes[fail].output;
+        }
+    }
+    at_core_free(queue);
+    return nodes;
+}
+
 /**
  * @brief   Set the AT urc table.
  */
 void at_obj_set_urc(at_obj_t *at, const urc_item_t *tbl, int count)
 {
     at_info_t *ai = obj_map(at);
+    int i;
+    if (ai->urc_index != NULL) {
+        at_core_free(ai->urc_index);
+        ai->urc_index = NULL;
+    }
     ai->urc_tbl      = tbl;
     ai->urc_tbl_size = count;
+    ai->urc_any      = count;
+    for (i = 0; i < count && tbl; i++) {
+        if (tbl[i].prefix == NULL || *tbl[i].prefix == '\0') {
+            ai->urc_any = i;
+            break;
+        }
+    }
+    if (tbl != NULL && count > 0) {
+        ai->urc_index = urc_index_build(tbl, count);
+        if (ai->urc_index == NULL)
+            AT_DEBUG(ai, "No memory for the URC index, use linear search.\r\n");
+    }
 }
 /**
  * @brief   Get the urc  recv buffer count.
@@ -672,18 +1938,124 @@ void at_obj_urc_set_enable(at_obj_t *at, int enable, unsigned short timeout)
     }
 }
 
+#if AT_URC_DEFER_EN
+/**
+ * @brief   Enable the deferred URC queue, the frames of the URC items marked with 'defer' 
+ *          are copied into the queue and the handlers are invoked by at_obj_urc_dispatch, 
+ *          so that slow handlers do not delay the reception.
+ * @param   notify  Invoked after a frame is queued (in the thread of at_obj_process), 
+ *                  it can be used to wake up the dispatching thread, fill in NULL if not required.
+ * @return  false - out of memory.
+ */
+bool at_obj_urc_defer_enable(at_obj_t *at, void (*notify)(at_obj_t *at))
+{
+    at_info_t *ai = obj_map(at);
+    if (ai->urc_queue == NULL) {
+        ai->urc_queue = at_core_malloc(sizeof(urc_queue_t));
+        if (ai->urc_queue == NULL)
+            return false;
+        memset(ai->urc_queue, 0, sizeof(urc_queue_t));
+    }
+    ai->urc_queue->notify = notify;
+    return true;
+}
+
+/**
+ * @brief   Dispatch the deferred URC frames (can be called from a thread other than that
+ *          of at_obj_process, but only one thread can dispatch the same AT object).
+ * @param   max  Maximum number of frames to dispatch, <= 0 means all.
+ * @return  Number of frames dispatched.
+ */
+int at_obj_urc_dispatch(at_obj_t *at, int max)
+{
+    at_info_t *ai = obj_map(at);
+    urc_queue_t *q = ai->urc_queue;
+    urc_record_t *rec;
+    at_urc_info_t info;
+    unsigned int tail, head;
+    bool stalled;
+    int n = 0;
+    if (q == NULL)
+        return 0;
+    tail = q->tail;
+    head = AT_LOAD_ACQUIRE(&q->head);
+    while (tail != head && (max <= 0 || n < max)) {
+        rec = &q->rec[tail & (AT_URC_QUEUE_DEPTH - 1)];
+        info.status = (urc_recv_status)rec->status;
+        info.urcbuf = &q->data[rec->data & (AT_URC_QUEUE_SIZE - 1)];
+        info.urclen = rec->len;
+        rec->item->handler(&info);
+        //Release the record and its frame data
+        AT_STORE_RELEASE(&q->data_tail, rec->data_end);
+        AT_STORE_RELEASE(&q->tail, ++tail);
+        n++;
+    }
+    stalled = AT_LOAD_ACQUIRE(&q->stalled);
+    AT_STORE_RELEASE(&q->stats.dispatched, q->stats.dispatched + n);
+    if (n > 0 && stalled)                       //Resume reading
+        at_wakeup(ai);
+    return n;
+}
+
+/**
+ * @brief   Get the statistics of the deferred URC queue.
+ */
+void at_obj_urc_get_stats(at_obj_t *at, at_urc_stats_t *stats)
+{
+    urc_queue_t *q = obj_map(at)->urc_queue;
+    if (q == NULL) {
+        memset(stats, 0, sizeof(at_urc_stats_t));
+        return;
+    }
+    stats->queued     = AT_LOAD_ACQUIRE(&q->stats.queued);
+    stats->dispatched = AT_LOAD_ACQUIRE(&q->stats.dispatched);
+    stats->dropped    = AT_LOAD_ACQUIRE(&q->stats.dropped);
+    stats->stalls     = AT_LOAD_ACQUIRE(&q->stats.stalls);
+}
+#endif
+
 /**
   * @brief Find a URC handler based on URC receive buffer information.
+  *        The receive buffer is scanned once through the URC prefix index, if 
+  *        several prefixes occur, the one in front of the URC table wins.
   */
 const urc_item_t *find_urc_item(at_info_t *ai, char *urc_buf, unsigned int size)
 {
     const urc_item_t *tbl = ai->urc_tbl;
-    int i;
-    for (i = 0; i < ai->urc_tbl_size && tbl; i++, tbl++) {
-       if (strstr(urc_buf, tbl->prefix ? tbl->prefix : ""))//It will need to be further optimized in the future.
-            return tbl;  
+    const urc_node_t *nodes = ai->urc_index;
+    unsigned short node = 0, next, out;
+    int i, best;
+    if (nodes == NULL) {
+        for (i = 0; i < ai->urc_tbl_size && tbl; i++, tbl++) {
+            if (strstr(urc_buf, tbl->prefix ? tbl->prefix : ""))
+                return tbl;  
+        }
+        return NULL;
     }
-    return NULL;
+    best = ai->urc_any;
+    for (i = 0; i < (int)size && urc_buf[i] != '\0' && best > 0; i++) {
+        while ((next = urc_index_goto(nodes, node, urc_buf[i])) == 0 && node != 0)
+            node = nodes[node].fail;
+        node = next;
+        for (out = nodes[node].item >= 0 ? node : nodes[node].output; out != 0; out = nodes[out].output) {
+            if (nodes[out].item < best)
+                best = nodes[out].item;
+        }
+    }
+    return best < ai->urc_tbl_size ? &ai->urc_tbl[best] : NULL;
+}
+
+/**
+ * @brief   Build the URC end mark classification table from AT_URC_END_MARKS.
+ */
+static void urc_mark_map_init(void)
+{
+    const char *p;
+    if (urc_mark_map[0])
+        return;
+    for (p = AT_URC_END_MARKS; *p; p++)
+        urc_mark_map[(unsigned char)*p] = 1;
+    urc_mark_map[0] = 1;
 }
 
 static void urc_reset(at_info_t *ai)
@@ -692,8 +2064,78 @@ static void urc_reset(at_info_t *ai)
     ai->urc_cnt    = 0;
     ai->urc_item   = NULL;
     ai->urc_match  = 0;
-	ai->urc_timer = at_get_ms();
+    ai->urc_view   = 0;
+	ai->urc_timer = ai->now;
+}
+
+#if AT_URC_DEFER_EN
+/**
+ * @brief       Copy a URC frame into the deferred URC queue (it is dropped if the queue is full).
+ * @return      0 (The frame is always finished).
+ */
+static int urc_queue_push(at_info_t *ai, urc_recv_status status, const char *urc, unsigned int size)
+{
+    urc_queue_t *q = ai->urc_queue;
+    urc_record_t *rec;
+    unsigned int head = q->head;
+    unsigned int tail = AT_LOAD_ACQUIRE(&q->tail);
+    unsigned int pos  = q->data_head;
+    unsigned int off;
+    if (head - tail >= AT_URC_QUEUE_DEPTH)
+        goto drop;
+    if (head == tail) {                                     //Drained, rewind the data ring.
+        q->data_head = q->data_tail = 0;
+        pos = 0;
+    }
+    off = pos & (AT_URC_QUEUE_SIZE - 1);
+    if (off + size + 1 > AT_URC_QUEUE_SIZE)                 //The frame is kept contiguous
+        pos += AT_URC_QUEUE_SIZE - off;
+    if (pos + size + 1 - AT_LOAD_ACQUIRE(&q->data_tail) > AT_URC_QUEUE_SIZE)
+        goto drop;
+    off = pos & (AT_URC_QUEUE_SIZE - 1);
+    memcpy(&q->data[off], urc, size);
+    q->data[off + size] = '\0';
+    rec = &q->rec[head & (AT_URC_QUEUE_DEPTH - 1)];
+    rec->item     = ai->urc_item;
+    rec->status   = status;
+    rec->len      = size;
+    rec->data     = pos;
+    rec->data_end = pos + size + 1;
+    q->data_head  = pos + size + 1;
+    AT_STORE_RELEASE(&q->stats.queued, q->stats.queued + 1);
+    AT_STORE_RELEASE(&q->head, head + 1);
+    if (q->notify != NULL)
+        q->notify(&ai->obj);
+    return 0;
+drop:
+    AT_STORE_RELEASE(&q->stats.dropped, q->stats.dropped + 1);
+    AT_DEBUG(ai, "URC queue full, frame dropped.\r\n");
+    return 0;
+}
+
+/**
+ * @brief       Indicates whether the reading should be paused, it is paused for at most 
+ *              AT_URC_STALL_TIME while the deferred URC queue is more than 3/4 full (the 
+ *              frames that still do not fit are dropped, ref@at_urc_stats_t.dropped).
+ */
+static bool urc_queue_stalled(at_info_t *ai)
+{
+    urc_queue_t *q = ai->urc_queue;
+    if (q == NULL)
+        return false;
+    if (q->head - AT_LOAD_ACQUIRE(&q->tail) < AT_URC_QUEUE_DEPTH &&
+        q->data_head - AT_LOAD_ACQUIRE(&q->data_tail) <= AT_URC_QUEUE_SIZE * 3 / 4) {
+        AT_STORE_RELEASE(&q->stalled, 0);
+        return false;
+    }
+    if (!q->stalled) {
+        q->stall_timer = ai->now;
+        AT_STORE_RELEASE(&q->stalled, 1);
+        AT_STORE_RELEASE(&q->stats.stalls, q->stats.stalls + 1);
+    }
+    return !AT_IS_TIMEOUT(ai, q->stall_timer, AT_URC_STALL_TIME);
 }
+#endif
 
 /**
  * @brief       URC(unsolicited code) handler entry.
@@ -710,6 +2152,11 @@ static void urc_handler_entry(at_info_t *ai, urc_recv_status status, char *urc,
     else 
         AT_DEBUG(ai, "<=\r\n%s\r\n", urc);    
     /* Send URC event notification. */
+#if AT_URC_DEFER_EN
+    if (ai->urc_queue != NULL && ai->urc_item != NULL && ai->urc_item->defer)
+        remain = urc_queue_push(ai, status, urc, size);
+    else
+#endif
     remain = ai->urc_item ? ai->urc_item->handler(&ctx) : 0;
     if (remain == 0 && (ai->urc_item || ai->cursor == NULL)) {
 
@@ -724,7 +2171,7 @@ static void urc_handler_entry(at_info_t *ai, urc_recv_status status, char *urc,
 static void urc_timeout_process(at_info_t *ai)
 {
     //Receive timeout processing, default (MAX_URC_RECV_TIMEOUT).
-    if (ai->urc_cnt > 0 && AT_IS_TIMEOUT(ai->urc_timer, AT_URC_TIMEOUT)) {        
+    if (ai->urc_cnt > 0 && AT_IS_TIMEOUT(ai, ai->urc_timer, AT_URC_TIMEOUT)) {        
         if (ai->urc_cnt > 2 && ai->urc_item != NULL) {
             ai->urcbuf[ai->urc_cnt] = '\0';
             AT_DEBUG(ai,"urc recv timeout=>%s\r\n", ai->urcbuf);       
@@ -735,58 +2182,135 @@ static void urc_timeout_process(at_info_t *ai)
 }
 
 /**
- * @brief       URC receive processing
+ * @brief       Indicates whether the URC frame being received is also the response 
+ *              of the running work (it contains the expected response prefix).
+ */
+static bool urc_is_response(at_info_t *ai)
+{
+    const char *prefix;
+    if (ai->cursor == NULL)
+        return false;
+    prefix = ai->cursor->attr.prefix;
+    return prefix != NULL && *prefix != '\0' && strstr(ai->urcbuf, prefix) != NULL;
+}
+
+/**
+ * @brief       Move the URC frame being received out of the response buffer (ref@urc_view) 
+ *              into the URC buffer.
+ */
+static void urc_frame_detach(at_info_t *ai)
+{
+    if (!ai->urc_view)
+        return;
+    ai->urc_view = 0;
+    memcpy(ai->urcbuf, ai->recvbuf + ai->recv_cnt - ai->urc_cnt, ai->urc_cnt);
+    ai->urcbuf[ai->urc_cnt] = '\0';
+}
+
+/**
+ * @brief       Receive one run of data, which ends at the next URC end mark or at the end
+ *              of the remaining binary data of the current URC frame. 
+ *              The run is routed once: while a work is running, the data that has not 
+ *              been claimed by a URC item is only appended to the response buffer, and the 
+ *              URC matcher looks at the frame in place (ref@urc_view). The frame is copied 
+ *              to the URC buffer when it is claimed, its bytes are then taken back from the 
+ *              response buffer unless the frame is also the response (ref@urc_is_response).
  * @param[in]   buf  - Receive buffer
- * @return      none
+ * @return      The number of bytes consumed.
  */
-static void urc_recv_process(at_info_t *ai, char *buf, unsigned int size)
+static unsigned int urc_recv_step(at_info_t *ai, const char *buf, unsigned int size)
 {
     char *urc_buf;
+    unsigned int n;
+    bool to_work;
     int ch;
+    if (ai->urc_match) {                                         /* Binary data of the current frame */
+        n = ai->urc_target > ai->urc_cnt ? ai->urc_target - ai->urc_cnt : 1;
+    } else {                                                     /* Find the URC end mark. */
+        for (n = 0; n < size && !urc_mark_map[(unsigned char)buf[n]]; n++) {}
+        if (n < size)
+            n++;
+    }
+    if (n > size)
+        n = size;
+    to_work = ai->cursor != NULL && (ai->urc_item == NULL || ai->urc_shared);
+    if (ai->urc_cnt + n >= ai->urc_bufsize) {                    /* Empty directly on overflow */
+        n = ai->urc_bufsize - ai->urc_cnt;
+        urc_reset(ai);
+        if (to_work)
+            resp_recv_process(ai, buf, n);
+        AT_DEBUG(ai, "Urc buffer full.\r\n");
+        return n;
+    }
+    if (to_work) {
+        resp_recv_process(ai, buf, n);                          //It may detach the frame on overflow
+        ai->urc_resp_cnt += n;
+        if (ai->urc_cnt == 0 && ai->urc_item == NULL)            //A new frame starts in the response
+            ai->urc_view = 1;
+    }
+    if (ai->urc_view) {
+        ai->urc_cnt += n;
+        urc_buf = ai->recvbuf + ai->recv_cnt - ai->urc_cnt;     //Terminated by resp_recv_process
+    } else {
+        urc_buf = ai->urcbuf;
+        memcpy(urc_buf + ai->urc_cnt, buf, n);
+        ai->urc_cnt += n;
+    }
+    if (ai->urc_match) {
+        if (ai->urc_cnt >= ai->urc_target)
+            urc_handler_entry(ai, URC_RECV_OK, urc_buf, ai->urc_cnt);
+        return n;
+    }
+    ch = buf[n - 1];
+    if (!urc_mark_map[(unsigned char)ch])                        /* No end mark in this run*/
+        return n;
+    urc_buf[ai->urc_cnt] = '\0';
+    if (ai->urc_item == NULL) {                                  //Find the corresponding URC handler                 
+        ai->urc_item = find_urc_item(ai, urc_buf, ai->urc_cnt);
+        if (ai->urc_item != NULL) {
+            urc_frame_detach(ai);
+            urc_buf        = ai->urcbuf;
+            ai->urc_shared = !AT_URC_EXCLUSIVE_EN || urc_is_response(ai);
+            if (!ai->urc_shared && ai->urc_resp_cnt > 0) {
+                //The frame was passed to the work before it was recognized.
+                ai->recv_cnt -= ai->urc_resp_cnt;
+                ai->recvbuf[ai->recv_cnt] = '\0';
+                if (ai->match_len > ai->recv_cnt)
+                    ai->match_len = ai->recv_cnt;
+                ai->urc_resp_cnt = 0;
+            }
+        } else if (ch == '\n') {
+            if (ai->urc_cnt > 2 && ai->cursor == NULL)           //Unrecognized URC message
+                AT_DEBUG(ai, "%s\r\n", urc_buf);
+            urc_reset(ai);
+            return n;
+        }
+    }            
+    if (ai->urc_item != NULL && ch == ai->urc_item->endmark)
+        urc_handler_entry(ai, URC_RECV_OK, urc_buf, ai->urc_cnt);  
+    return n;
+}
+
+/**
+ * @brief       Prepare the URC matcher for the received data.
+ * @return      Indicates whether the URC matcher takes the received data.
+ */
+static bool urc_recv_begin(at_info_t *ai, unsigned int size)
+{
     if (ai->urcbuf == NULL)
-        return;
+        return false;
     if (size == 0) {
         urc_timeout_process(ai);
-        return;
+        return false;
     }
     if (!ai->urc_enable) {
-        if (!AT_IS_TIMEOUT(ai->urc_timer, ai->urc_disable_time))
-            return;
+        if (!AT_IS_TIMEOUT(ai, ai->urc_timer, ai->urc_disable_time))
+            return false;
         ai->urc_enable = 1;
         AT_DEBUG(ai, "Enable the URC match handler\r\n");
     }    
-	ai->urc_timer = at_get_ms();
-    urc_buf  = ai->urcbuf;
-    while (size--) {
-        ch = *buf++;
-        urc_buf[ai->urc_cnt++] = ch;
-        if (ai->urc_cnt >= ai->urc_bufsize) {                   /* Empty directly on overflow */
-            urc_reset(ai);
-            AT_DEBUG(ai, "Urc buffer full.\r\n");
-            continue;
-        }
-        if (ai->urc_match) {
-            if (ai->urc_cnt >= ai->urc_target){
-                urc_handler_entry(ai, URC_RECV_OK, urc_buf, ai->urc_cnt);
-            }                                                    
-            continue;
-        }
-        if (strchr(AT_URC_END_MARKS, ch) == NULL && ch != '\0')  // Find the URC end mark.
-            continue;
-        urc_buf[ai->urc_cnt] = '\0';
-        if (ai->urc_item == NULL) {                              //Find the corresponding URC handler                 
-            ai->urc_item = find_urc_item(ai, urc_buf, ai->urc_cnt);
-            if (ai->urc_item == NULL && ch == '\n') {
-                if (ai->urc_cnt > 2 && ai->cursor == NULL)       //Unrecognized URC message
-                    AT_DEBUG(ai, "%s\r\n", urc_buf);
-                urc_reset(ai);
-                continue;
-            }
-        }            
-        if (ai->urc_item != NULL && ch == ai->urc_item->endmark)
-            urc_handler_entry(ai, URC_RECV_OK, urc_buf, ai->urc_cnt);  
-    }
-          
+	ai->urc_timer = ai->now;
+    return true;
 }
 #endif
 /**
@@ -798,147 +2322,622 @@ static void resp_recv_process(at_info_t *ai, const char *buf, unsigned int size)
     if (size == 0) return;
 
     if (ai->recv_cnt + size >= ai->recv_bufsize) //Receive overflow, clear directly.
-        ai->recv_cnt = 0;
+        recv_reset(ai);
 
     memcpy(ai->recvbuf + ai->recv_cnt, buf, size);    
     ai->recv_cnt += size;
     ai->recvbuf[ai->recv_cnt] = '\0';
 }
 
-static int (*const work_handler_table[WORK_TYPE_MAX])(at_info_t *) = {
-    [WORK_TYPE_GENERAL]   = do_work_handler,
-    [WORK_TYPE_SINGLLINE] = do_cmd_handler,
-    [WORK_TYPE_MULTILINE] = send_multiline_handler,
-    [WORK_TYPE_CMD]       = do_cmd_handler,
-    [WORK_TYPE_CUSTOM]    = do_cmd_handler,
-    [WORK_TYPE_BUF]       = do_cmd_handler,
-};
-
 /**
- * @brief   AT work processing.
+ * @brief       Received data demultiplexing.
+ *              The data is split into runs at the URC end marks, and each run is routed
+ *              once: the URC frames claimed by the URC table go to the URC handler only, 
+ *              the other data goes to the running work (it is dropped when idle, because
+ *              the response buffer is cleared when the next work starts).
+ */
+static void recv_process(at_info_t *ai, char *buf, unsigned int size)
+{
+#if AT_URC_WARCH_EN
+    unsigned int n;
+    if (urc_recv_begin(ai, size)) {
+        while (size > 0) {
+            n = urc_recv_step(ai, buf, size);
+            if (ai->urc_cnt == 0)                       //The URC frame has ended.
+                ai->urc_resp_cnt = 0;
+            buf  += n;
+            size -= n;
+        }
+        //The work handler may modify or clear the response buffer.
+        urc_frame_detach(ai);
+        return;
+    }
+#endif
+    if (ai->cursor != NULL)
+        resp_recv_process(ai, buf, size);
+}
+
+static int (*const work_handler_table[WORK_TYPE_MAX])(at_info_t *) = {
+    [WORK_TYPE_GENERAL]   = do_work_handler,
+    [WORK_TYPE_SINGLLINE] = do_cmd_handler,
+    [WORK_TYPE_MULTILINE] = send_multiline_handler,
+    [WORK_TYPE_CMD]       = do_cmd_handler,
+    [WORK_TYPE_CUSTOM]    = do_cmd_handler,
+    [WORK_TYPE_BUF]       = do_cmd_handler,
+};
+
+/**
+ * @brief   Indicates whether the work has stayed in the queue longer than its time to live.
+ */
+static inline bool work_is_expired(at_info_t *ai, const work_item_t *it)
+{
+    return it->life != 0 && AT_IS_TIMEOUT(ai, it->stamp, it->life * 1000U);
+}
+
+/**
+ * @brief   Move the first expired work in the queues to the head of its queue, so that the 
+ *          expired works are finished before the next work starts, instead of waiting for 
+ *          every work queued before them (the lock must be held).
+ * @return  The queue of the expired work, NULL: none.
+ */
+static struct list_head *work_queue_expire(at_info_t *ai)
+{
+    struct list_head *pos;
+    work_item_t *it;
+    int i;
+    for (i = AT_PRIORITY_LEVELS - 1; i >= 0; i--) {
+        list_for_each(pos, &ai->queue[i]) {
+            it = list_entry(pos, work_item_t, node);
+            if (it->state == AT_WORK_STAT_READY && work_is_expired(ai, it)) {
+                list_move(pos, &ai->queue[i]);
+                return &ai->queue[i];
+            }
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief   AT work processing.
+ */
+static void at_work_process(at_info_t *ai)
+{
+    at_env_t *env = &ai->env;
+    struct list_head *elist;
+    bool expired;
+#if AT_CQ_EN
+    if (!cq_retry(ai))
+        return;                         //The completion queue is still full.
+#endif
+    do {                                //The expired works are skipped in a row.
+        expired = false;
+        if (ai->cursor == NULL) {
+            ai->clist = work_queue_pick(ai);
+            if (ai->clist == NULL)
+                return; //No work to do.
+#if !AT_LOCKFREE_SUBMIT_EN
+            at_lock(ai);
+#endif
+            elist = work_queue_expire(ai);
+            if (elist != NULL)
+                ai->clist = elist;
+            ai->next_delay = 0;
+            env->obj    = (struct at_obj *)ai;
+            env->i      = 0;
+            env->j      = 0;
+            env->state  = 0;
+            ai->cursor  = list_first_entry(ai->clist, work_item_t, node);
+            env->params = ai->cursor->attr.params;
+            env->recvclr(env);
+            env->reset_timer(env);
+            /*Enter running state*/
+            if (ai->cursor->state == AT_WORK_STAT_READY) {            
+                expired = work_is_expired(ai, ai->cursor);
+                if (!expired)
+                    update_work_state(ai->cursor, AT_WORK_STAT_RUN, (at_resp_code)ai->cursor->code);
+            }
+#if !AT_LOCKFREE_SUBMIT_EN
+            at_unlock(ai);
+#endif
+            if (expired) {
+                AT_DEBUG(ai, "Work expired in queue.\r\n");
+                ai->prefix = ai->suffix = NULL;
+                do_at_callback(ai, ai->cursor, AT_RESP_EXPIRED);
+            }
+        }
+        /* When the job execution is complete, put it into the idle work queue */
+        if (ai->cursor->state >= AT_WORK_STAT_FINISH || work_handler_table[ai->cursor->type](ai)) {
+#if AT_CQ_EN
+            if (ai->cq_wait != NULL)    //Keep the work until its completion is queued.
+                return;
+#endif
+            //Marked the work as done.
+            if (ai->cursor->state == AT_WORK_STAT_RUN) {            
+                update_work_state(ai->cursor, AT_WORK_STAT_FINISH, (at_resp_code)ai->cursor->code);
+            }            
+#if AT_SYNC_EN
+            work_item_notify(ai->cursor);
+#endif
+            //Recycle Processed work item.
+            work_item_recycle(ai, ai->cursor);
+            ai->cursor = NULL;
+        }
+    } while (expired);
+}
+
+/**
+ * @brief  Create an AT object with the specified adapter (one of 'adap' and 'adap_ex').
+ */
+static at_obj_t *obj_create(const at_adapter_t *adap, const at_adapter_ex_t *adap_ex, void *user_data,
+                            unsigned short recv_bufsize, unsigned short urc_bufsize)
+{
+    at_env_t *e;
+    int i;
+    at_info_t *ai = at_core_malloc(sizeof(at_info_t));
+    if (ai == NULL)
+        return NULL;
+    memset(ai, 0, sizeof(at_info_t));
+    ai->obj.adap      = adap;
+    ai->obj.adap_ex   = adap_ex;
+    ai->obj.user_data = user_data;
+    /* Initialize the work queue of each priority level*/
+    for (i = 0; i < AT_PRIORITY_LEVELS; i++)
+        INIT_LIST_HEAD(&ai->queue[i]);
+#if AT_RESP_CACHE_EN
+    INIT_LIST_HEAD(&ai->cache);
+#endif
+#if AT_TIMER_WHEEL_EN
+    at_timer_init(&ai->sched_timer);
+    INIT_LIST_HEAD(&ai->sched_node);
+#endif
+#if AT_RETRY_POLICY_EN
+    //Different objects get different jitter sequences.
+    ai->rand_seed = (unsigned int)(unsigned long)ai ^ (at_get_ms() << 16) ^ 0x9E3779B9U;
+    if (ai->rand_seed == 0)
+        ai->rand_seed = 1;
+#endif
+    //Allocate at least 32 bytes to the buffer
+    ai->recv_bufsize = recv_bufsize < 32 ? 32 : recv_bufsize;
+    ai->recvbuf      = at_core_malloc(ai->recv_bufsize);
+    if (ai->recvbuf == NULL) {
+        at_obj_destroy(&ai->obj);
+        return NULL;
+    }
+#if AT_URC_WARCH_EN    
+    urc_mark_map_init();
+    if (urc_bufsize != 0) {
+        ai->urc_bufsize  = urc_bufsize < 32 ? 32 : urc_bufsize;
+        ai->urcbuf       = at_core_malloc(ai->urc_bufsize);
+        if (ai->urcbuf == NULL) {
+            at_obj_destroy(&ai->obj);
+            return NULL;
+        }         
+    }
+#endif
+    e              = &ai->env;
+    ai->recv_cnt   = 0;
+    ai->urc_enable = 1;
+    ai->enable     = 1;
+    //Initialization of public work environment.
+    e->is_timeout  = at_is_timeout;
+    e->println     = println;
+    e->recvbuf     = get_recvbuf;
+    e->recvclr     = recvbuf_clear;
+    e->recvlen     = get_recv_count;
+    e->contains    = find_substr;
+    e->disposing   = at_isabort;
+    e->finish      = at_finish;
+    e->reset_timer = at_reset_timer;
+    e->next_wait   = at_next_wait;
+    return &ai->obj;
+}
+
+/**
+ * @brief  Create an AT object
+ * @param  adap AT interface adapter (AT object only saves its pointer, it must be a global resident object)
+ * @return Pointer to a new AT object
+ */
+at_obj_t *at_obj_create(const at_adapter_t *adap)
+{
+#if AT_URC_WARCH_EN
+    return obj_create(adap, NULL, NULL, adap->recv_bufsize, adap->urc_bufsize);
+#else
+    return obj_create(adap, NULL, NULL, adap->recv_bufsize, 0);
+#endif
+}
+
+/**
+ * @brief  Create an AT object with an object context adapter.
+ * @param  adap      AT interface adapter (AT object only saves its pointer, it must be a 
+ *                   global resident object), it can be shared by multiple AT objects.
+ * @param  user_data User data (ref@at_obj_get_user_data), usually the device context used 
+ *                   by the adapter interfaces.
+ * @return Pointer to a new AT object
+ */
+at_obj_t *at_obj_create_ex(const at_adapter_ex_t *adap, void *user_data)
+{
+#if AT_URC_WARCH_EN
+    return obj_create(NULL, adap, user_data, adap->recv_bufsize, adap->urc_bufsize);
+#else
+    return obj_create(NULL, adap, user_data, adap->recv_bufsize, 0);
+#endif
+}
+/**
+ * @brief  Destroy a AT object.
+ */
+void at_obj_destroy(at_obj_t *obj)
+{
+    at_info_t *ai = obj_map(obj);
+    int i;
+
+    if (obj == NULL)
+        return;
+#if AT_TIMER_WHEEL_EN
+    at_sched_remove(obj);
+#endif
+#if AT_LOCKFREE_SUBMIT_EN
+    work_inbox_drain(ai);
+#endif
+    for (i = 0; i < AT_PRIORITY_LEVELS; i++)
+        work_item_destroy_all(ai, &ai->queue[i]);
+#if AT_WORK_POOL_EN
+    work_pool_flush(ai);
+#endif
+
+    if (ai->recvbuf != NULL)
+        at_core_free(ai->recvbuf);
+    if (ai->txbuf != NULL)
+        at_core_free(ai->txbuf);
+#if AT_URC_WARCH_EN        
+    if (ai->urcbuf != NULL)
+        at_core_free(ai->urcbuf);
+    if (ai->urc_index != NULL)
+        at_core_free(ai->urc_index);
+#if AT_URC_DEFER_EN
+    if (ai->urc_queue != NULL)
+        at_core_free(ai->urc_queue);
+#endif
+#endif
+#if AT_RESP_CACHE_EN
+    while (!list_empty(&ai->cache))
+        cache_remove(ai, list_first_entry(&ai->cache, cache_entry_t, node));
+#endif
+    at_core_free(ai);
+
+}
+
+/**
+ * @brief   Indicates if the AT object is busy.
+ * @return  true - command queue is not empty, busy state
+ */
+bool at_obj_busy(at_obj_t *at)
+{
+#if AT_LOCKFREE_SUBMIT_EN
+    return AT_ATOMIC_LOAD(&obj_map(at)->list_cnt) != 0 || obj_map(at)->urc_cnt != 0;
+#else
+    return work_queue_pick(obj_map(at)) != NULL || obj_map(at)->urc_cnt != 0;
+#endif
+}
+
+/**
+ * @brief   Get the remaining time of a timer.
+ */
+static unsigned int time_remain(unsigned int now, unsigned int start, unsigned int ms)
+{
+    unsigned int elapsed = now - start;
+    return elapsed > ms ? 0 : ms - elapsed + 1;
+}
+
+/**
+ * @brief   Get the time until at_obj_process needs to be invoked again.
+ *          The caller can sleep until this time expires or at_obj_notify_rx is 
+ *          invoked (see at_adapter_t.wakeup), instead of polling periodically.
+ * @return  The waiting time (ms), 0 means that there is work to be processed 
+ *          immediately, AT_WAIT_FOREVER means that the AT object is idle.
+ * @note    It should be invoked in the same thread as at_obj_process.
+ */
+unsigned int at_obj_next_deadline(at_obj_t *at)
+{
+    at_info_t *ai = obj_map(at);
+    work_item_t *wi = ai->cursor;
+    unsigned int now = at_get_ms();
+    unsigned int wait = AT_WAIT_FOREVER;
+#if AT_CQ_EN
+    if (ai->cq_wait != NULL)                            //Wait for the completion queue.
+        return AT_WORK_POLL_INTERVAL;
+#endif
+    if (ai->rx_pending)
+        return 0;
+#if AT_LOCKFREE_SUBMIT_EN
+    if (AT_ATOMIC_LOAD(&ai->inbox) != NULL || AT_ATOMIC_LOAD(&ai->abort_req))
+        return 0;
+#endif
+#if AT_RAW_TRANSPARENT_EN
+    if (ai->raw_trans)
+        return AT_WORK_POLL_INTERVAL;
+#endif
+    if (wi == NULL) {
+        if (work_queue_pick(ai) != NULL)
+            return 0;
+    } else if (wi->state >= AT_WORK_STAT_FINISH) {
+        return 0;
+    } else if (wi->type == WORK_TYPE_GENERAL) {         //Custom work is polled periodically.
+        wait = ai->next_delay > 0 ? time_remain(now, ai->delay_timer, ai->next_delay) 
+                                  : AT_WORK_POLL_INTERVAL;
+    } else if (ai->env.state == AT_STAT_SEND) {
+        return 0;
+    } else {
+        wait = time_remain(now, ai->timer, ai->wait_time);
+    }
+#if AT_URC_WARCH_EN
+    if (ai->urc_cnt > 0) {
+        now = time_remain(now, ai->urc_timer, AT_URC_TIMEOUT);
+        wait = now < wait ? now : wait;
+    }
+#if AT_URC_DEFER_EN
+    if (ai->urc_queue != NULL && ai->urc_queue->stalled)
+        wait = AT_WORK_POLL_INTERVAL < wait ? AT_WORK_POLL_INTERVAL : wait;
+#endif
+#endif
+    return wait;
+}
+
+/**
+ * @brief   Notify the AT object that data has been received (it can be invoked in 
+ *          the receive interrupt), the adapter 'wakeup' interface will be invoked.
+ */
+void at_obj_notify_rx(at_obj_t *at)
+{
+    obj_map(at)->rx_pending = 1;
+    at_wakeup(obj_map(at));
+}
+
+#if AT_TIMER_WHEEL_EN
+
+#define WHEEL_MASK (AT_WHEEL_SLOTS - 1)
+
+#if (AT_WHEEL_SLOTS < 32) || (AT_WHEEL_SLOTS & WHEEL_MASK)
+    #error "AT_WHEEL_SLOTS must be a power of 2 and not less than 32"
+#endif
+
+/**
+ * @brief  Number of trailing zero bits (x != 0).
+ */
+static inline unsigned int wheel_ctz(unsigned int x)
+{
+#if defined(__GNUC__)
+    return __builtin_ctz(x);
+#else
+    unsigned int n = 0;
+    while (!(x & 1)) {
+        x >>= 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+/**
+ * @brief  Initialize a timer wheel.
+ * @param  now Current time(ms)
+ */
+void at_wheel_init(at_wheel_t *w, unsigned int now)
+{
+    int i;
+    for (i = 0; i < AT_WHEEL_SLOTS; i++)
+        INIT_LIST_HEAD(&w->slots[i]);
+    memset(w->bitmap, 0, sizeof(w->bitmap));
+    w->current = now;
+    w->count   = 0;
+}
+
+/**
+ * @brief  Initialize a timer.
+ */
+void at_timer_init(at_timer_t *t)
+{
+    INIT_LIST_HEAD(&t->node);
+}
+
+/**
+ * @brief  Indicates if the timer is in a timer wheel.
+ */
+bool at_timer_pending(const at_timer_t *t)
+{
+    return !list_empty(&t->node);
+}
+
+/**
+ * @brief  Add a timer to the timer wheel (the expiration time is updated if it is 
+ *         already in the wheel).
+ * @param  expires Expiration time(ms)
+ */
+void at_wheel_add(at_wheel_t *w, at_timer_t *t, unsigned int expires)
+{
+    unsigned int slot;
+    at_wheel_del(w, t);
+    //Expired timers are put into the current slot and handled on the next advance.
+    slot = (int)(expires - w->current) < 0 ? w->current & WHEEL_MASK : expires & WHEEL_MASK;
+    t->expires = expires;
+    t->slot    = slot;
+    list_add_tail(&t->node, &w->slots[slot]);
+    w->bitmap[slot / 32] |= 1U << (slot % 32);
+    w->count++;
+}
+
+/**
+ * @brief  Remove a timer from the timer wheel.
  */
-static void at_work_process(at_info_t *ai)
+void at_wheel_del(at_wheel_t *w, at_timer_t *t)
 {
-    at_env_t *env = &ai->env;
-    if (ai->cursor == NULL) {
-        if (!list_empty(&ai->hlist))
-            ai->clist = &ai->hlist;
-        else if (!list_empty(&ai->llist))
-            ai->clist = &ai->llist;
-        else
-            return; //No work to do.
+    if (!at_timer_pending(t))
+        return;
+    list_del_init(&t->node);
+    if (list_empty(&w->slots[t->slot]))
+        w->bitmap[t->slot / 32] &= ~(1U << (t->slot % 32));
+    w->count--;
+}
 
-        at_lock(ai);
-        ai->next_delay = 0;
-        env->obj    = (struct at_obj *)ai;
-        env->i      = 0;
-        env->j      = 0;
-        env->state  = 0;
-        ai->cursor  = list_first_entry(ai->clist, work_item_t, node);
-        env->params = ai->cursor->attr.params;
-        env->recvclr(env);
-        env->reset_timer(env);
-        /*Enter running state*/
-        if (ai->cursor->state == AT_WORK_STAT_READY) {            
-            update_work_state(ai->cursor, AT_WORK_STAT_RUN, (at_resp_code)ai->cursor->code);
+/**
+ * @brief  Advance the timer wheel to the specified time, expired timers are removed 
+ *         from the wheel and passed to 'expire' (only the slots passed are checked, 
+ *         timers longer than one round stay in their slots).
+ * @param  now    Current time(ms)
+ * @param  expire Expiration handler, the timer can be added again in it.
+ */
+void at_wheel_advance(at_wheel_t *w, unsigned int now, void (*expire)(at_timer_t *t, void *arg), void *arg)
+{
+    struct list_head expired, *pos, *n;
+    unsigned int steps, slot;
+    at_timer_t *t;
+    if ((int)(now - w->current) < 0)
+        return;
+    steps = now - w->current + 1;
+    if (steps > AT_WHEEL_SLOTS)
+        steps = AT_WHEEL_SLOTS;
+    INIT_LIST_HEAD(&expired);
+    while (steps-- > 0 && w->count > 0) {
+        slot = (now - steps) & WHEEL_MASK;
+        if (!(w->bitmap[slot / 32] & (1U << (slot % 32))))
+            continue;
+        list_for_each_safe(pos, n, &w->slots[slot]) {
+            t = list_entry(pos, at_timer_t, node);
+            if ((int)(t->expires - now) <= 0) {
+                at_wheel_del(w, t);
+                list_add_tail(&t->node, &expired);
+            }
         }
-        at_unlock(ai);
     }
-    /* When the job execution is complete, put it into the idle work queue */
-    if (ai->cursor->state >= AT_WORK_STAT_FINISH || work_handler_table[ai->cursor->type](ai)) {
-        //Marked the work as done.
-        if (ai->cursor->state == AT_WORK_STAT_RUN) {            
-            update_work_state(ai->cursor, AT_WORK_STAT_FINISH, (at_resp_code)ai->cursor->code);
-        }            
-        //Recycle Processed work item.
-        work_item_recycle(ai, ai->cursor);
-        ai->cursor = NULL;
+    w->current = now;
+    list_for_each_safe(pos, n, &expired) {
+        t = list_entry(pos, at_timer_t, node);
+        list_del_init(&t->node);
+        expire(t, arg);
     }
 }
 
 /**
- * @brief  Create an AT object
- * @param  adap AT interface adapter (AT object only saves its pointer, it must be a global resident object)
- * @return Pointer to a new AT object
+ * @brief  Get the time until the next slot that may expire (invoked after at_wheel_advance).
+ * @param  now Current time(ms)
+ * @return The waiting time(ms), AT_WAIT_FOREVER if the wheel is empty.
  */
-at_obj_t *at_obj_create(const at_adapter_t *adap)
-{
-    at_env_t *e;
-    at_info_t *ai = at_core_malloc(sizeof(at_info_t));
-    if (ai == NULL)
-        return NULL;
-    memset(ai, 0, sizeof(at_info_t));
-    ai->obj.adap = adap;
-    /* Initialize high and low priority queues*/
-    INIT_LIST_HEAD(&ai->hlist);
-    INIT_LIST_HEAD(&ai->llist);
-    //Allocate at least 32 bytes to the buffer
-    ai->recv_bufsize = adap->recv_bufsize < 32 ? 32 : adap->recv_bufsize;
-    ai->recvbuf      = at_core_malloc(ai->recv_bufsize);
-    if (ai->recvbuf == NULL) {
-        at_obj_destroy(&ai->obj);
-        return NULL;
-    }
-#if AT_URC_WARCH_EN    
-    if (adap->urc_bufsize != 0) {
-        ai->urc_bufsize  = adap->urc_bufsize < 32 ? 32 : adap->urc_bufsize;
-        ai->urcbuf       = at_core_malloc(ai->urc_bufsize);
-        if (ai->urcbuf == NULL) {
-            at_obj_destroy(&ai->obj);
-            return NULL;
-        }         
+unsigned int at_wheel_next(const at_wheel_t *w, unsigned int now)
+{
+    unsigned int bits, d = 1, slot;
+    if (w->count == 0)
+        return AT_WAIT_FOREVER;
+    while (d < AT_WHEEL_SLOTS) {
+        slot = (now + d) & WHEEL_MASK;
+        bits = w->bitmap[slot / 32] >> (slot % 32);
+        if (bits != 0) {
+            d += wheel_ctz(bits);
+            break;
+        }
+        d += 32 - slot % 32;
     }
-#endif
-    e              = &ai->env;
-    ai->recv_cnt   = 0;
-    ai->urc_enable = 1;
-    ai->enable     = 1;
-    //Initialization of public work environment.
-    e->is_timeout  = at_is_timeout;
-    e->println     = println;
-    e->recvbuf     = get_recvbuf;
-    e->recvclr     = recvbuf_clear;
-    e->recvlen     = get_recv_count;
-    e->contains    = find_substr;
-    e->disposing   = at_isabort;
-    e->finish      = at_finish;
-    e->reset_timer = at_reset_timer;
-    e->next_wait   = at_next_wait;
-    return &ai->obj;
+    return d < AT_WHEEL_SLOTS ? d : AT_WHEEL_SLOTS;
 }
+
 /**
- * @brief  Destroy a AT object.
+ * @brief  Initialize a scheduler.
+ * @param  lock/unlock Protect the ready list (ref@at_sched_t), fill in NULL if not required.
  */
-void at_obj_destroy(at_obj_t *obj)
+void at_sched_init(at_sched_t *s, void (*lock)(void), void (*unlock)(void))
 {
-    at_info_t *ai = obj_map(obj);
-
-    if (obj == NULL)
-        return;
-
-    work_item_destroy_all(ai, &ai->hlist);
-    work_item_destroy_all(ai, &ai->llist);
+    at_wheel_init(&s->wheel, at_get_ms());
+    INIT_LIST_HEAD(&s->ready);
+    s->lock   = lock;
+    s->unlock = unlock;
+}
 
-    if (ai->recvbuf != NULL)
-        at_core_free(ai->recvbuf);
-#if AT_URC_WARCH_EN        
-    if (ai->urcbuf != NULL)
-        at_core_free(ai->urcbuf);
-#endif
-    at_core_free(ai);
+/**
+ * @brief  Add an AT object to the scheduler, it will be processed on the next at_sched_poll.
+ * @note   An object can only be driven by one scheduler, and it should no longer be 
+ *         processed by at_obj_process elsewhere.
+ */
+void at_sched_add(at_sched_t *s, at_obj_t *at)
+{
+    at_info_t *ai = obj_map(at);
+    at_sched_remove(at);
+    ai->sched = s;
+    sched_ready(s, ai);
+}
 
+/**
+ * @brief  Remove an AT object from its scheduler (at_obj_destroy does it automatically).
+ * @note   It should be invoked in the thread of at_sched_poll.
+ */
+void at_sched_remove(at_obj_t *at)
+{
+    at_info_t *ai = obj_map(at);
+    at_sched_t *s = ai->sched;
+    if (s == NULL)
+        return;
+    if (s->lock != NULL)
+        s->lock();
+    list_del_init(&ai->sched_node);
+    ai->sched = NULL;
+    if (s->unlock != NULL)
+        s->unlock();
+    at_wheel_del(&s->wheel, &ai->sched_timer);
 }
 
 /**
- * @brief   Indicates if the AT object is busy.
- * @return  true - command queue is not empty, busy state
+ * @brief  The deadline of an object is reached.
  */
-bool at_obj_busy(at_obj_t *at)
+static void sched_expire(at_timer_t *t, void *arg)
 {
-    return !list_empty(&obj_map(at)->hlist) || !list_empty(&obj_map(at)->llist) 
-        || obj_map(at)->urc_cnt != 0;
+    sched_ready((at_sched_t *)arg, list_entry(t, at_info_t, sched_timer));
+}
+
+/**
+ * @brief  Process the AT objects of the scheduler that have received data, submitted 
+ *         requests or reached their deadlines, idle objects are not touched.
+ * @return The time until at_sched_poll needs to be invoked again (ms), the caller can 
+ *         sleep until it expires or an object is woken up (ref@at_adapter_t.wakeup).
+ *         0 means that there are objects to be processed immediately, AT_WAIT_FOREVER 
+ *         means that all objects are idle.
+ */
+unsigned int at_sched_poll(at_sched_t *s)
+{
+    struct list_head ready;
+    at_info_t *ai;
+    unsigned int now = at_get_ms(), wait;
+    at_wheel_advance(&s->wheel, now, sched_expire, s);
+    INIT_LIST_HEAD(&ready);
+    if (s->lock != NULL)
+        s->lock();
+    list_splice_init(&s->ready, &ready);
+    if (s->unlock != NULL)
+        s->unlock();
+    while (!list_empty(&ready)) {
+        ai = list_first_entry(&ready, at_info_t, sched_node);
+        if (s->lock != NULL)
+            s->lock();
+        list_del_init(&ai->sched_node);               //It can be made ready again from now on.
+        if (s->unlock != NULL)
+            s->unlock();
+        at_obj_process(&ai->obj);
+        if (ai->sched != s)                           //Removed in the callbacks.
+            continue;
+        wait = at_obj_next_deadline(&ai->obj);
+        if (wait == 0)
+            sched_ready(s, ai);
+        else if (wait == AT_WAIT_FOREVER)
+            at_wheel_del(&s->wheel, &ai->sched_timer);
+        else
+            at_wheel_add(&s->wheel, &ai->sched_timer, now + wait);
+    }
+    if (s->lock != NULL)
+        s->lock();
+    wait = list_empty(&s->ready) ? at_wheel_next(&s->wheel, now) : 0;
+    if (s->unlock != NULL)
+        s->unlock();
+    return wait;
 }
 
+#endif //End of AT_TIMER_WHEEL_EN
+
 /**
  * @brief   Enable/Disable the AT work
  */
@@ -963,6 +2962,16 @@ void *at_obj_get_user_data(at_obj_t *at)
     return at->user_data;
 }
 
+/**
+ * @brief   Write raw data through the object's adapter (works for both 'adap' and 'adap_ex').
+ * @param   buf  Data buffer
+ * @param   len  Data length
+ */
+void at_obj_write(at_obj_t *at, const void *buf, unsigned int len)
+{
+    send_data(obj_map(at), buf, len);
+}
+
 /**
  * @brief   Default attributes initialization.
  *          Default low priority, other reference AT_DEF_XXX definition.
@@ -982,20 +2991,39 @@ void at_attr_deinit(at_attr_t *attr)
  */
 bool at_exec_vcmd(at_obj_t *at, const at_attr_t *attr, const char *cmd, va_list va)
 {
-    char *buf;
+    at_info_t *ai = obj_map(at);
+    work_item_t *it;
+    char buf[64];                               //Most of the commands are short enough for it.
+    va_list args;
     int len;
-    void *workid = NULL;
-    buf = at_core_malloc(AT_MAX_CMD_LEN);
-    if (buf == NULL) {
-        AT_DEBUG(obj_map(at), "No memory when execute vcmd...\r\n");
-        return NULL;
+    va_copy(args, va);
+    len = vsnprintf(buf, sizeof(buf), cmd, args);
+    va_end(args);
+    if (len <= 0)
+        return false;
+    if (len >= AT_MAX_CMD_LEN)
+        len = AT_MAX_CMD_LEN - 1;
+    if (len < (int)sizeof(buf)) {
+#if AT_RESP_CACHE_EN
+        if (cache_complete(ai, attr, buf))
+            return true;
+#endif
+        return add_work_item(ai, WORK_TYPE_CMD, attr, buf, len + 1) != NULL;
     }
-    len = vsnprintf(buf, AT_MAX_CMD_LEN, cmd, va);
-    if (len > 0) {
-        workid = add_work_item(obj_map(at), WORK_TYPE_CMD, attr, buf, len + 1);
+    //Format the long command into the work item directly.
+    it = create_work_item(ai, WORK_TYPE_CMD, attr, NULL, len + 1);
+    if (it == NULL)
+        return false;
+    vsnprintf(it->buf, len + 1, cmd, va);
+#if AT_RESP_CACHE_EN
+    if (cache_complete(ai, attr, it->buf)) {
+        at_lock(ai);
+        work_item_destroy(ai, it);
+        at_unlock(ai);
+        return true;
     }
-    at_core_free(buf);
-    return workid != NULL;
+#endif
+    return sumit_work_item(ai, it) != NULL;
 }
 
 /**
@@ -1018,7 +3046,7 @@ bool at_exec_cmd(at_obj_t *at, const at_attr_t *attr, const char *cmd, ...)
 /**
  * @brief   Execute custom command
  * @param   attr AT attributes(NULL to use the default value)
- * @param   sender Command sending handler (such as sending any type of data through the env->obj->adap-write interface)
+ * @param   sender Command sending handler (such as sending any type of data through the at_obj_write(env->obj, ...) interface)
  * @retval  Indicates whether the asynchronous work was enqueued successfully
  */
 bool at_custom_cmd(at_obj_t *at, const at_attr_t *attr, void (*sender)(at_env_t *env))
@@ -1047,6 +3075,10 @@ bool at_send_data(at_obj_t *at, const at_attr_t *attr, const void *databuf, unsi
  */
 bool at_send_singlline(at_obj_t *at, const at_attr_t *attr, const char *singlline)
 {
+#if AT_RESP_CACHE_EN
+    if (cache_complete(obj_map(at), attr, singlline))
+        return true;
+#endif
     return add_work_item(obj_map(at), WORK_TYPE_SINGLLINE, attr, singlline, 0) != NULL;
 }
 
@@ -1086,58 +3118,178 @@ bool at_do_work(at_obj_t *at, void *params, at_work_t work)
 
 /**
  * @brief Abort all AT work
+ * @note  When AT_LOCKFREE_SUBMIT_EN is enabled, the abort is performed by the next 
+ *        at_obj_process, so the work submitted before that will also be aborted.
  */
 void at_work_abort_all(at_obj_t *at)
 {
-    struct list_head *pos;
-    work_item_t *it;
+#if AT_LOCKFREE_SUBMIT_EN
+    AT_ATOMIC_STORE(&obj_map(at)->abort_req, 1);
+    at_wakeup(obj_map(at));
+#else
     at_info_t *ai = obj_map(at);    
     at_lock(ai);
-    list_for_each(pos, &ai->hlist) {
-        it = list_entry(pos, work_item_t, node);
-        update_work_state(it, AT_WORK_STAT_ABORT, AT_RESP_ABORT);
+    work_queue_abort(ai);
+    at_unlock(ai);
+    at_wakeup(ai);
+#endif
+}
+
+#if AT_RESP_CACHE_EN
+/**
+ * @brief  Invalidate the cached response.
+ * @param  cmd  Command string (same as the one sent, without "\r\n"), NULL to clear the cache.
+ */
+void at_obj_cache_invalidate(at_obj_t *at, const char *cmd)
+{
+    at_info_t *ai = obj_map(at);
+    struct list_head *pos, *n;
+    cache_entry_t *e;
+    at_lock(ai);
+    list_for_each_safe(pos, n, &ai->cache) {
+        e = list_entry(pos, cache_entry_t, node);
+        if (cmd == NULL || strcmp(e->data, cmd) == 0)
+            cache_remove(ai, e);
     }
-    list_for_each(pos, &ai->llist) {
-        it = list_entry(pos, work_item_t, node);
-        update_work_state(it, AT_WORK_STAT_ABORT, AT_RESP_ABORT);
+    at_unlock(ai);
+}
+
+/**
+ * @brief  Get the statistics of the response cache.
+ */
+void at_obj_cache_get_stats(at_obj_t *at, at_cache_stats_t *stats)
+{
+    at_info_t *ai = obj_map(at);
+    at_lock(ai);
+    *stats = ai->cache_stats;
+    at_unlock(ai);
+}
+#endif
+
+#if AT_ADAPTIVE_TIMEOUT_EN
+/**
+ * @brief  Get the response time statistics of the command verb (ref@at_attr_t.adaptive).
+ * @param  cmd   Command line in the same form as executed, such as "AT+CREG?", "AT+CREG=2",
+ *               "ATD10086;" (the forms of a verb are measured apart).
+ * @return true - The response time of the verb has been measured.
+ */
+bool at_obj_get_rtt_stats(at_obj_t *at, const char *cmd, at_rtt_stats_t *stats)
+{
+    at_info_t *ai = obj_map(at);
+    unsigned short verb = rtt_verb_hash(cmd);
+    bool ret = false;
+    int i;
+    at_lock(ai);
+    for (i = 0; i < AT_RTT_SLOTS; i++) {
+        if (ai->rtt[i].valid && ai->rtt[i].verb == verb) {
+            stats->srtt    = ai->rtt[i].srtt >> 3;
+            stats->rttvar  = ai->rtt[i].rttvar >> 2;
+            stats->timeout = rtt_rto(&ai->rtt[i]);
+            ret = true;
+            break;
+        }
     }
     at_unlock(ai);
+    return ret;
 }
+#endif
 
 #if AT_MEM_WATCH_EN
 
+/**
+ * @brief  Add a block to the memory statistics (the AT objects may be processed by different 
+ *         threads, so the statistics are updated atomically).
+ * @param  nbytes Block size (without the header).
+ * @param  force  Add it even if the limit would be exceeded.
+ * @return false - The maximum memory limit would be exceeded.
+ */
+static bool mem_stat_add(unsigned long nbytes, bool force)
+{
+    unsigned int size = nbytes + sizeof(unsigned long);
+#if defined(__GNUC__)
+    unsigned int cur = __atomic_load_n(&at_cur_mem, __ATOMIC_RELAXED);
+    unsigned int max;
+    do {
+        if (!force && nbytes + cur > AT_MEM_LIMIT_SIZE)
+            return false;
+    } while (!__atomic_compare_exchange_n(&at_cur_mem, &cur, cur + size, true, 
+                                          __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    cur += size;
+    max = __atomic_load_n(&at_max_mem, __ATOMIC_RELAXED);
+    while (cur > max && !__atomic_compare_exchange_n(&at_max_mem, &max, cur, true, 
+                                                     __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+#else
+    if (!force && nbytes + at_cur_mem > AT_MEM_LIMIT_SIZE)
+        return false;
+    at_cur_mem += size;
+    if (at_cur_mem > at_max_mem)
+        at_max_mem = at_cur_mem;
+#endif
+    return true;
+}
+
+static void mem_stat_sub(unsigned long nbytes)
+{
+#if defined(__GNUC__)
+    __atomic_fetch_sub(&at_cur_mem, nbytes + sizeof(unsigned long), __ATOMIC_RELAXED);
+#else
+    at_cur_mem -= (nbytes + sizeof(unsigned long));
+#endif
+}
+
 static void *at_core_malloc(unsigned int nbytes)
 {
-    if (nbytes + at_cur_mem > AT_MEM_LIMIT_SIZE) { //The maximum memory limit has been exceeded.
+    unsigned long *mem_info;
+    if (!mem_stat_add(nbytes, false)) { //The maximum memory limit has been exceeded.
         return NULL;
     }
-    unsigned long *mem_info = (unsigned long *)at_malloc(nbytes + sizeof(unsigned long));
-    *mem_info = nbytes;
-    at_cur_mem += (nbytes + sizeof(unsigned long) ); //Statistics of current memory usage.
-    if (at_cur_mem > at_max_mem) { //Record maximum memory usage.
-        at_max_mem = at_cur_mem;
+    mem_info = (unsigned long *)at_malloc(nbytes + sizeof(unsigned long));
+    if (mem_info == NULL) {
+        mem_stat_sub(nbytes);
+        return NULL;
     }
+    *mem_info = nbytes;
     return mem_info + 1;
 }
 
 static void  at_core_free(void *ptr)
 {
     unsigned long *mem_info = (unsigned long *)ptr;
-    unsigned long nbytes;
     if (ptr != NULL) {
         mem_info--;
-        nbytes = *mem_info;
-        at_cur_mem -= (nbytes + sizeof(unsigned long) );
+        mem_stat_sub(*mem_info);
         at_free(mem_info);
     }
 }
 
+#if AT_WORK_POOL_EN
+/**
+ * @brief  Charge a block kept out of the memory statistics (ref@at_core_uncharge) again.
+ * @param  force Charge it even if the limit would be exceeded (the block is going to be freed).
+ * @return false - The maximum memory limit would be exceeded.
+ */
+static bool at_core_charge(void *ptr, bool force)
+{
+    return mem_stat_add(((unsigned long *)ptr)[-1], force);
+}
+
+/**
+ * @brief  Keep a block allocated by at_core_malloc out of the memory statistics (the idle 
+ *         work items kept in the pool are not counted as used memory).
+ */
+static void at_core_uncharge(void *ptr)
+{
+    mem_stat_sub(((unsigned long *)ptr)[-1]);
+}
+#endif
+
 /**
  * @brief Get the maximum memory usage.
  */
 unsigned int at_max_used_memory(void)
 {    
-    return at_max_mem;
+    return AT_LOAD_ACQUIRE(&at_max_mem);
 }
 
 /**
@@ -1145,7 +3297,7 @@ unsigned int at_max_used_memory(void)
  */
 unsigned int at_cur_used_memory(void)
 {
-    return at_cur_mem;
+    return AT_LOAD_ACQUIRE(&at_cur_mem);
 }
 
 #else 
@@ -1160,6 +3312,20 @@ static void  at_core_free(void *ptr)
     at_free(ptr);
 }
 
+#if AT_WORK_POOL_EN
+static bool at_core_charge(void *ptr, bool force)
+{
+    (void)ptr;
+    (void)force;
+    return true;
+}
+
+static void at_core_uncharge(void *ptr)
+{
+    (void)ptr;
+}
+#endif
+
 #endif
 
 #if AT_WORK_CONTEXT_EN
@@ -1211,12 +3377,13 @@ void at_context_attach(at_attr_t *attr, at_context_t *ctx)
  */
 at_work_state at_work_get_state(at_context_t *ctx)
 {
-    return ctx->work_state;
+    return AT_LOAD_ACQUIRE(&ctx->work_state);
 }
 
 bool at_work_is_busy(at_context_t *ctx)
 {
-    return ctx->work_state == AT_WORK_STAT_RUN || ctx->work_state == AT_WORK_STAT_READY;
+    at_work_state state = AT_LOAD_ACQUIRE(&ctx->work_state);
+    return state == AT_WORK_STAT_RUN || state == AT_WORK_STAT_READY;
 }
 /**
  * @brief  Indicate whether the work has been finished (then you can call `at_work_get_result` to query the result)
@@ -1225,7 +3392,7 @@ bool at_work_is_busy(at_context_t *ctx)
  */
 bool at_work_is_finish(at_context_t *ctx)
 {
-    return ctx->work_state > AT_WORK_STAT_RUN;
+    return AT_LOAD_ACQUIRE(&ctx->work_state) > AT_WORK_STAT_RUN;
 }
 
 /**
@@ -1237,6 +3404,181 @@ at_resp_code  at_work_get_result(at_context_t *ctx)
     return ctx->code;
 }
 
+#if AT_SYNC_EN
+/**
+ * @brief  Initialize a work context that can be waited (ref@at_wait).
+ * @param  ctx     - Pointer to 'at_context_t'
+ * @param  respbuf Command response buffer, fill in NULL if not required
+ * @param  bufsize Buffer size (must be long enough to receive all responses)
+ * @return true - success, false - failed to create the semaphore.
+ */
+bool at_context_sync_init(at_context_t *ctx, void *respbuf, unsigned bufsize)
+{
+    at_context_init(ctx, respbuf, bufsize);
+    ctx->sem = at_sem_create();
+    return ctx->sem != NULL;
+}
+
+/**
+ * @brief  Release the semaphore of the work context.
+ */
+void at_context_sync_deinit(at_context_t *ctx)
+{
+    if (ctx->sem != NULL)
+        at_sem_destroy(ctx->sem);
+    ctx->sem = NULL;
+}
+
+/**
+ * @brief  Wait for the work attached to the context to be finished, the waiting thread 
+ *         is woken up when the work item is recycled.
+ * @param  ctx     AT context (initialized by at_context_sync_init)
+ * @param  timeout Waiting time(ms), AT_WAIT_FOREVER means waiting until it is finished.
+ * @return true - the work has been finished, false - timeout
+ * @note   If it times out, the context must remain valid until the work is finished.
+ */
+bool at_wait(at_context_t *ctx, unsigned int timeout)
+{
+    return at_sem_wait(ctx->sem, timeout) == 0;
+}
+
+/**
+ * @brief   Execute command and wait for it to finish (with variable argument list)
+ * @param   attr AT attributes(NULL to use the default value)
+ * @param   ctx  AT context used to receive the response (initialized by at_context_init or 
+ *               at_context_sync_init), fill in NULL if not required.
+ * @param   cmd  Format the command.
+ * @param   va   Variable parameter list
+ * @return  Command response code.
+ */
+at_resp_code at_exec_vcmd_sync(at_obj_t *at, const at_attr_t *attr, at_context_t *ctx, const char *cmd, va_list va)
+{
+    at_context_t local;
+    at_attr_t    sync_attr;
+    at_sem_t     sem = NULL;
+    if (ctx == NULL) {
+        ctx = &local;
+        at_context_init(ctx, NULL, 0);
+    }
+    if (ctx->sem == NULL) {
+        if ((sem = ctx->sem = at_sem_create()) == NULL)
+            return AT_RESP_ERROR;
+    }
+    if (attr == NULL)
+        at_attr_deinit(&sync_attr);
+    else
+        sync_attr = *attr;
+    at_context_attach(&sync_attr, ctx);
+    if (!at_exec_vcmd(at, &sync_attr, cmd, va)) {
+        AT_STORE_RELEASE(&ctx->work_state, AT_WORK_STAT_IDLE);
+        ctx->code = AT_RESP_ERROR;
+    } else {
+        at_wait(ctx, AT_WAIT_FOREVER);
+    }
+    if (sem != NULL) {                   //Created temporarily
+        at_sem_destroy(sem);
+        ctx->sem = NULL;
+    }
+    return ctx->code;
+}
+
+/**
+ * @brief   Execute command and wait for it to finish.
+ * @param   attr AT attributes(NULL to use the default value)
+ * @param   ctx  AT context used to receive the response, fill in NULL if not required.
+ * @param   cmd  Format the command.
+ * @return  Command response code.
+ */
+at_resp_code at_exec_cmd_sync(at_obj_t *at, const at_attr_t *attr, at_context_t *ctx, const char *cmd, ...)
+{
+    at_resp_code code;
+    va_list args;
+    va_start(args, cmd);
+    code = at_exec_vcmd_sync(at, attr, ctx, cmd, args);
+    va_end(args);
+    return code;
+}
+#endif
+
+#endif
+
+#if AT_CQ_EN
+/**
+ * @brief  Initialize a completion queue.
+ * @param  entries  Entry buffer
+ * @param  count    Number of entries (must be a power of 2)
+ * @param  databuf  Response data buffer
+ * @param  bufsize  Data buffer size (must be a power of 2 and at least twice the response 
+ *                  buffer size of the AT object, ref@at_obj_set_cq)
+ * @return false - invalid parameters.
+ */
+bool at_cq_init(at_cq_t *cq, at_cqe_t *entries, unsigned int count, void *databuf, unsigned int bufsize)
+{
+    if (entries == NULL || databuf == NULL || count == 0 || bufsize == 0 ||
+        (count & (count - 1)) != 0 || (bufsize & (bufsize - 1)) != 0)
+        return false;
+    memset(cq, 0, sizeof(at_cq_t));
+    cq->entries     = entries;
+    cq->entry_count = count;
+    cq->data        = (char *)databuf;
+    cq->data_size   = bufsize;
+    return true;
+}
+
+/**
+ * @brief  Bind a completion queue to the AT object, the response callbacks of the finished 
+ *         works are no longer invoked in at_obj_process, but are queued and dispatched by 
+ *         at_cq_reap. If the queue is full, the object stops reading the device and keeps the 
+ *         finished work until the completion can be queued (ref@at_cq_t.overflow).
+ * @param  cq Completion queue (initialized by at_cq_init), NULL to disable.
+ * @return false - The data ring is smaller than twice the response buffer size, a response 
+ *         kept contiguous may never fit in it.
+ * @note   Each AT object requires its own completion queue, it should be set before any work 
+ *         is submitted.
+ */
+bool at_obj_set_cq(at_obj_t *at, at_cq_t *cq)
+{
+    at_info_t *ai = obj_map(at);
+    if (cq != NULL && cq->data_size < 2U * ai->recv_bufsize)
+        return false;
+    ai->cq = cq;
+    return true;
+}
+
+/**
+ * @brief  Dispatch the queued completions (can be called from a thread other than that 
+ *         of at_obj_process, but only one thread can reap the same queue).
+ * @param  max  Maximum number of completions to dispatch, <= 0 means all.
+ * @return Number of completions dispatched.
+ */
+int at_cq_reap(at_obj_t *at, int max)
+{
+    at_cq_t *cq = obj_map(at)->cq;
+    at_response_t r;
+    at_cqe_t *e;
+    unsigned int tail, head;
+    int n = 0;
+    if (cq == NULL)
+        return 0;
+    tail = cq->tail;
+    head = AT_LOAD_ACQUIRE(&cq->head);
+    while (tail != head && (max <= 0 || n < max)) {
+        e = &cq->entries[tail & (cq->entry_count - 1)];
+        r.obj     = at;
+        r.params  = e->params;
+        r.code    = e->code;
+        r.recvcnt = e->recvcnt;
+        r.recvbuf = &cq->data[e->data & (cq->data_size - 1)];
+        r.prefix  = r.recvbuf + e->prefix;
+        r.suffix  = r.recvbuf + e->suffix;
+        e->cb(&r);
+        //Release the entry and its response data
+        AT_STORE_RELEASE(&cq->data_tail, e->data_end);
+        AT_STORE_RELEASE(&cq->tail, ++tail);
+        n++;
+    }
+    return n;
+}
 #endif
 
 #if AT_RAW_TRANSPARENT_EN
@@ -1251,13 +3593,13 @@ static void at_raw_trans_process(at_obj_t *obj)
     at_info_t *ai = obj_map(obj);
     if (obj->raw_conf == NULL)
         return;
-    size = obj->adap->read(rbuf, sizeof(rbuf));
+    size = adap_read(ai, rbuf, sizeof(rbuf));
     if (size > 0 ){
         obj->raw_conf->write(rbuf, size);
     }
     size = obj->raw_conf->read(rbuf, sizeof(rbuf));
     if (size > 0) {
-        obj->adap->write(rbuf, size);
+        send_data(ai, rbuf, size);
     } 
     //Exit command detection
     if (obj->raw_conf->exit_cmd != NULL) {
@@ -1306,11 +3648,15 @@ void at_raw_transport_exit(at_obj_t *obj)
 
 /**
  * @brief  AT work polling processing.
+ *         All the received data is drained in chunks of AT_RECV_CHUNK_SIZE (up to 
+ *         AT_RECV_BUDGET bytes per call), and the running work is processed after 
+ *         each chunk.
  */
 void at_obj_process(at_obj_t *at)
 {
-    char rbuf[64];
-    int read_size;
+    char rbuf[AT_RECV_CHUNK_SIZE];
+    unsigned int budget = AT_RECV_BUDGET;
+    unsigned int read_size;
     register at_info_t *ai = obj_map(at);
 #if AT_RAW_TRANSPARENT_EN
     if (ai->raw_trans) {
@@ -1318,11 +3664,28 @@ void at_obj_process(at_obj_t *at)
         return;
     }    
 #endif    
-    read_size = __get_adapter(ai)->read(rbuf, sizeof(rbuf));
-#if AT_URC_WARCH_EN
-        urc_recv_process(ai, rbuf, read_size);
+    ai->rx_pending = 0;
+#if AT_LOCKFREE_SUBMIT_EN
+    work_inbox_drain(ai);
+#endif
+    do {
+        ai->now   = at_get_ms();
+#if AT_URC_DEFER_EN
+        if (urc_queue_stalled(ai))              //Back pressure: leave the data in the device
+            read_size = 0;
+        else
+#endif
+#if AT_CQ_EN
+        if (ai->cq_wait != NULL)                //The response buffer is still in use.
+            read_size = 0;
+        else
 #endif
-    resp_recv_process(ai, rbuf, read_size);
-    at_work_process(ai);
+        read_size = adap_read(ai, rbuf, sizeof(rbuf));
+        recv_process(ai, rbuf, read_size);
+        at_work_process(ai);
+        budget = read_size < budget ? budget - read_size : 0;
+    } while (read_size > 0 && budget > 0);
+    if (read_size > 0)                          //The budget is used up, more data may be buffered.
+        ai->rx_pending = 1;
 }
 